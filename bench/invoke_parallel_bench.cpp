@@ -0,0 +1,53 @@
+// Measures how InvokeParallel scales with the number of pool workers.
+// Usage: invoke_parallel_bench [max workers] [handlers] [work per handler] [raises]
+
+#include "delegate.h"
+#include "delegate_thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static size_t Arg(int argc, char **argv, int index, size_t defaultValue)
+{
+    return index < argc ? static_cast<size_t>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned hardware = std::thread::hardware_concurrency();
+    size_t maxWorkers = Arg(argc, argv, 1, hardware > 1 ? hardware - 1 : 1);
+    size_t handlers   = Arg(argc, argv, 2, 256);
+    size_t work       = Arg(argc, argv, 3, 2000);
+    size_t raises     = Arg(argc, argv, 4, 50);
+
+    Action<size_t> d;
+    for (size_t i = 0; i < handlers; ++i) {
+        d += [work](size_t x) {
+            volatile double a = static_cast<double>(x);
+            for (size_t k = 0; k < work; ++k) {
+                a = a * 1.0000001 + 1;
+            }
+        };
+    }
+
+    std::printf("%zu handlers, %zu iterations each, %u hardware threads\n", handlers, work, hardware);
+    std::printf("%8s %12s %8s\n", "workers", "ms/raise", "speedup");
+    double baseline = 0;
+    for (size_t workers = 0; workers <= maxWorkers; workers = workers == 0 ? 1 : workers * 2) {
+        DelegateThreadPool pool(workers, 1);
+        d.InvokeParallel(pool, 0); // warm up the workers
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < raises; ++r) {
+            d.InvokeParallel(pool, r);
+        }
+        auto end  = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count() / static_cast<double>(raises);
+        if (workers == 0) {
+            baseline = ms;
+        }
+        std::printf("%8zu %12.3f %8.2f\n", workers, ms, baseline / ms);
+    }
+    return 0;
+}
@@ -1,388 +1,3580 @@
 #ifndef _DELEGATE_H_
 #define _DELEGATE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <vector>
-#include <exception>
+
+#if defined(_MSVC_LANG)
+#define _DELEGATE_CPLUSPLUS _MSVC_LANG
+#else
+#define _DELEGATE_CPLUSPLUS __cplusplus
+#endif
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+#include <memory_resource>
+#include <optional>
+#endif
+
+// Define DELEGATE_NO_EXCEPTIONS to build without any throw sites, it is defined automatically
+// when exceptions are disabled.
+#if !defined(DELEGATE_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define DELEGATE_NO_EXCEPTIONS
+#endif
+
+// What invoking an empty delegate does, define DELEGATE_EMPTY_POLICY to one of these.
+// DELEGATE_EMPTY_DEFAULT does nothing and returns a default constructed result.
+#define DELEGATE_EMPTY_THROW 0
+#define DELEGATE_EMPTY_ABORT 1
+#define DELEGATE_EMPTY_DEFAULT 2
+
+#if !defined(DELEGATE_EMPTY_POLICY)
+#if defined(DELEGATE_NO_EXCEPTIONS)
+#define DELEGATE_EMPTY_POLICY DELEGATE_EMPTY_ABORT
+#else
+#define DELEGATE_EMPTY_POLICY DELEGATE_EMPTY_THROW
+#endif
+#endif
+
+#if DELEGATE_EMPTY_POLICY == DELEGATE_EMPTY_THROW && defined(DELEGATE_NO_EXCEPTIONS)
+#error "DELEGATE_EMPTY_THROW requires exceptions"
+#endif
+
+#if defined(_MSC_VER)
+#define _DELEGATE_COLD __declspec(noinline)
+#else
+#define _DELEGATE_COLD __attribute__((noinline, cold))
+#endif
+
+// SSE2 is used to scan the fingerprints of large invocation lists, define DELEGATE_NO_SIMD to disable it.
+// The scan is inline in every translation unit, so it sticks to the x86-64 baseline instead of an AVX2 path
+// that depends on per-file compiler flags. For the same reason DELEGATE_NO_SIMD is set for the whole program.
+#if !defined(DELEGATE_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define _DELEGATE_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+// Thread pool used by Delegate::InvokeParallel. It is defined in delegate_thread_pool.h, so only code that
+// invokes delegates in parallel depends on <thread>, include that header to call InvokeParallel.
+class DelegateThreadPool;
+
+// Customization point for comparing and hashing callables of type T, used by Remove, Contains and the
+// other lookups. Specialize it with static Equals and Hash functions, equal callables must have equal hashes.
+// By default function pointers are compared with ==, stateless callables of the same type, e.g. captureless
+// lambdas, are equal and other types with operator== are compared with it. Those are hashed with std::hash<T>
+// if it is specialized, otherwise they all hash to 0 and lookups compare them one by one, so specialize
+// std::hash or this struct for such callables that are looked up often. Trivially copyable callables, e.g.
+// lambdas capturing pointers and integers, are compared bytewise. Delegates store copies of those with memcpy,
+// so a callable equals its stored copies even if it has padding. Other callables are never equal.
+template <typename T, typename = void>
+struct DelegateCallableTraits {
+    static bool Equals(const T &a, const T &b)
+    {
+        return _Equals(a, b, _Kind());
+    }
+
+    static size_t Hash(const T &callable)
+    {
+        return _Hash(callable, _Kind());
+    }
+
+private:
+    enum _KindValue { _Pointer, _EqualityOperator, _Stateless, _Bytes, _None };
+
+    template <typename U>
+    static auto _HasEqualityOperator(int) -> decltype(std::declval<const U &>() == std::declval<const U &>(), std::true_type());
+
+    template <typename U>
+    static std::false_type _HasEqualityOperator(...);
+
+    template <typename U>
+    static auto _HasStdHash(int) -> decltype(std::hash<U>()(std::declval<const U &>()), std::true_type());
+
+    template <typename U>
+    static std::false_type _HasStdHash(...);
+
+    // Empty types are checked first, captureless lambdas have operator== through their conversion to a
+    // function pointer, which compares the addresses of their static invokers.
+    using _Kind = std::integral_constant<_KindValue,
+                                         std::is_pointer<T>::value || std::is_member_pointer<T>::value ? _Pointer
+                                         : std::is_empty<T>::value                                       ? _Stateless
+                                         : decltype(_HasEqualityOperator<T>(0))::value                   ? _EqualityOperator
+                                         : std::is_trivially_copyable<T>::value                          ? _Bytes
+                                                                                                         : _None>;
+
+public:
+    // All callables of type T are equal, delegates identify them by their type alone.
+    using _AllEqual = std::integral_constant<bool, _Kind::value == _Stateless>;
+
+private:
+
+    static size_t _HashBytes(const void *data, size_t size)
+    {
+        // FNV-1a
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        uint64_t hash              = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    static bool _Equals(const T &a, const T &b, std::integral_constant<_KindValue, _Pointer>)
+    {
+        return a == b;
+    }
+
+    static size_t _Hash(const T &callable, std::integral_constant<_KindValue, _Pointer>)
+    {
+        return _HashBytes(&callable, sizeof(T));
+    }
+
+    static bool _Equals(const T &a, const T &b, std::integral_constant<_KindValue, _EqualityOperator>)
+    {
+        return a == b;
+    }
+
+    static size_t _Hash(const T &callable, std::integral_constant<_KindValue, _EqualityOperator>)
+    {
+        return _StdHash(callable, decltype(_HasStdHash<T>(0))());
+    }
+
+    static size_t _StdHash(const T &callable, std::true_type)
+    {
+        return std::hash<T>()(callable);
+    }
+
+    static size_t _StdHash(const T &, std::false_type)
+    {
+        return 0;
+    }
+
+    static bool _Equals(const T &, const T &, std::integral_constant<_KindValue, _Stateless>)
+    {
+        return true;
+    }
+
+    static size_t _Hash(const T &, std::integral_constant<_KindValue, _Stateless>)
+    {
+        return 0;
+    }
+
+    static bool _Equals(const T &a, const T &b, std::integral_constant<_KindValue, _Bytes>)
+    {
+        return memcmp(&a, &b, sizeof(T)) == 0;
+    }
+
+    static size_t _Hash(const T &callable, std::integral_constant<_KindValue, _Bytes>)
+    {
+        return _HashBytes(&callable, sizeof(T));
+    }
+
+    static bool _Equals(const T &, const T &, std::integral_constant<_KindValue, _None>)
+    {
+        return false;
+    }
+
+    static size_t _Hash(const T &, std::integral_constant<_KindValue, _None>)
+    {
+        return 0;
+    }
+};
+
+// Identifies a callable added with Delegate::AddWithHandle, see Delegate::Remove(DelegateHandle).
+// A default constructed handle does not identify any callable.
+struct DelegateHandle {
+    uint64_t id   = 0;
+    uint32_t slot = 0;
+
+    explicit operator bool() const
+    {
+        return id != 0;
+    }
+
+    // Ids are unique within the process, so a stale handle never matches a later callable.
+    static uint64_t _NextId()
+    {
+        static std::atomic<uint64_t> lastId(0);
+        return lastId.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+};
+
+// Arguments as passed to all callables but the last one of a multicast invocation. Arguments taken by value
+// are shared as const lvalues, so they are left intact for the following callables.
+template <typename A>
+using _DelegateSharedArg = typename std::conditional<std::is_lvalue_reference<A>::value, A, const typename std::remove_reference<A>::type &>::type;
+
+// Whether a callable that only accepts rvalues can receive an argument without moving from the shared one.
+template <typename A>
+struct _DelegateIsCopyableArg : std::integral_constant<bool,
+                                                       std::is_lvalue_reference<A>::value ||
+                                                           std::is_copy_constructible<typename std::remove_reference<A>::type>::value> {
+};
+
+// Arguments as passed to a callable that is not the last one but only accepts rvalues: it receives its own copy
+// of the arguments taken by value. Arguments that cannot be copied are moved.
+template <typename A>
+using _DelegateOwnArg = typename std::conditional<!std::is_lvalue_reference<A>::value && _DelegateIsCopyableArg<A>::value,
+                                                  typename std::remove_reference<A>::type, A &&>::type;
+
+template <bool...>
+struct _DelegateBools {
+};
 
 template <typename>
+struct _DelegateSignature;
+
+// The parts of the delegate types that only depend on the signature: the function and member function pointer
+// types, the callables that bind member functions, the comparison of stored callables, how the arguments of a
+// call are passed to the callables and what invoking an empty delegate does. Delegate, StaticDelegate,
+// InplaceDelegate and FunctionRef share it, so they treat callables alike.
+#if _DELEGATE_CPLUSPLUS >= 201703L
+template <typename TRet, typename... Args, bool NoExcept>
+struct _DelegateSignature<TRet(Args...) noexcept(NoExcept)> {
+    static constexpr bool _NoExcept = NoExcept;
+
+    using _FunctionPointer = TRet (*)(Args...) noexcept(NoExcept);
+
+    template <typename TObject>
+    using _MethodPointer = TRet (TObject::*)(Args...) noexcept(NoExcept);
+
+    template <typename TObject>
+    using _ConstMethodPointer = TRet (TObject::*)(Args...) const noexcept(NoExcept);
+#else
+template <typename TRet, typename... Args>
+struct _DelegateSignature<TRet(Args...)> {
+    static constexpr bool _NoExcept = false;
+
+    using _FunctionPointer = TRet (*)(Args...);
+
+    template <typename TObject>
+    using _MethodPointer = TRet (TObject::*)(Args...);
+
+    template <typename TObject>
+    using _ConstMethodPointer = TRet (TObject::*)(Args...) const;
+#endif
+
+    // Callables receive the arguments by reference to the parameters of the raising call. Unless
+    // forwardArgs is set they are passed as _SharedArg, so arguments taken by value are left intact
+    // for the following callables, otherwise they are forwarded and may be moved from.
+    template <typename A>
+    using _ArgRef = typename std::remove_reference<A>::type &;
+    template <typename A>
+    using _SharedArg = _DelegateSharedArg<A>;
+
+    // Whether no argument is moved from unless forwardArgs is set, see _DelegateOwnArg.
+    using _CopyableArgs = std::is_same<_DelegateBools<true, _DelegateIsCopyableArg<Args>::value...>,
+                                       _DelegateBools<_DelegateIsCopyableArg<Args>::value..., true>>;
+
+    // Whether T can be invoked with shared arguments, callables taking an argument as an rvalue
+    // reference cannot and receive their own copy of the arguments, see _DelegateOwnArg.
+    template <typename T>
+    struct _AcceptsSharedArgs {
+        template <typename U>
+        static auto Test(int) -> decltype(std::declval<const U &>()(std::declval<_SharedArg<Args>>()...), std::true_type());
+        template <typename U>
+        static std::false_type Test(...);
+        using type = decltype(Test<T>(0));
+    };
+
+    template <typename T>
+    static TRet _Invoke(const T &callable, bool forwardArgs, _ArgRef<Args>... args) noexcept(_NoExcept)
+    {
+        static_assert(!_NoExcept || noexcept(callable(std::declval<Args>()...)),
+                      "a noexcept delegate only accepts noexcept callables");
+        if (forwardArgs) {
+            return callable(static_cast<Args &&>(args)...);
+        }
+        return _InvokeShared(callable, typename _AcceptsSharedArgs<T>::type(), args...);
+    }
+
+    template <typename T>
+    static TRet _InvokeShared(const T &callable, std::true_type, _ArgRef<Args>... args) noexcept(_NoExcept)
+    {
+        static_assert(!_NoExcept || noexcept(callable(std::declval<_SharedArg<Args>>()...)),
+                      "a noexcept delegate only accepts noexcept callables");
+        return callable(static_cast<_SharedArg<Args>>(args)...);
+    }
+
+    template <typename T>
+    static TRet _InvokeShared(const T &callable, std::false_type, _ArgRef<Args>... args) noexcept(_NoExcept)
+    {
+        return callable(static_cast<_DelegateOwnArg<Args>>(args)...);
+    }
+
+    // Kept out of line so that invocation sites do not carry the empty delegate path, see DELEGATE_EMPTY_POLICY.
+    _DELEGATE_COLD static TRet _InvokeEmpty(std::false_type)
+    {
+#if DELEGATE_EMPTY_POLICY == DELEGATE_EMPTY_THROW
+        throw std::runtime_error("empty delegate");
+#elif DELEGATE_EMPTY_POLICY == DELEGATE_EMPTY_ABORT
+        std::abort();
+#else
+        return TRet();
+#endif
+    }
+
+    // noexcept delegates abort instead of throwing.
+    _DELEGATE_COLD static TRet _InvokeEmpty(std::true_type) noexcept
+    {
+#if DELEGATE_EMPTY_POLICY == DELEGATE_EMPTY_DEFAULT
+        return TRet();
+#else
+        std::abort();
+#endif
+    }
+
+    template <typename TObject>
+    struct _MemberFunctionWrapper {
+        TObject *_pObj;
+        _MethodPointer<TObject> _func;
+        _MemberFunctionWrapper(TObject &obj, _MethodPointer<TObject> func)
+            : _pObj(&obj), _func(func)
+        {
+        }
+        TRet operator()(Args... args) const noexcept(_NoExcept)
+        {
+            return (_pObj->*_func)(std::forward<Args>(args)...);
+        }
+    };
+
+    template <typename TObject>
+    struct _ConstMemberFunctionWrapper {
+        const TObject *_pObj;
+        _ConstMethodPointer<TObject> _func;
+        _ConstMemberFunctionWrapper(const TObject &obj, _ConstMethodPointer<TObject> func)
+            : _pObj(&obj), _func(func)
+        {
+        }
+        TRet operator()(Args... args) const noexcept(_NoExcept)
+        {
+            return (_pObj->*_func)(std::forward<Args>(args)...);
+        }
+    };
+
+    // Callable returned by Bind, the function is part of the type so it is called directly.
+    template <_FunctionPointer Func>
+    struct _FunctionBinding {
+        TRet operator()(Args... args) const noexcept(_NoExcept)
+        {
+            return Func(std::forward<Args>(args)...);
+        }
+    };
+
+    // Callable returned by Bind, the member function is part of the type so it is called directly.
+    template <typename TObject, typename TMethod, TMethod Method>
+    struct _MethodBinding {
+        TObject *_pObj;
+        TRet operator()(Args... args) const noexcept(noexcept((std::declval<TObject *>()->*Method)(std::declval<Args>()...)))
+        {
+            return (_pObj->*Method)(std::forward<Args>(args)...);
+        }
+    };
+
+    // Functions and function pointers are stored as _FunctionPointer, so they compare equal
+    // however they were passed, e.g. a noexcept function added to a delegate that is not noexcept.
+    template <typename T>
+    using _StoredType = typename std::conditional<(std::is_function<T>::value || std::is_pointer<T>::value) &&
+                                                      std::is_convertible<T &, _FunctionPointer>::value,
+                                                  _FunctionPointer, T>::type;
+
+    // Equality and hashing of the stored callables, other types use DelegateCallableTraits.
+    // Equal callables must have equal hashes.
+    template <typename T>
+    static bool _CallableEquals(const T &a, const T &b)
+    {
+        return DelegateCallableTraits<T>::Equals(a, b);
+    }
+
+    template <typename T>
+    static size_t _CallableHash(const T &callable)
+    {
+        return DelegateCallableTraits<T>::Hash(callable);
+    }
+
+    template <typename TObject>
+    static bool _CallableEquals(const _MemberFunctionWrapper<TObject> &a, const _MemberFunctionWrapper<TObject> &b)
+    {
+        return a._pObj == b._pObj && a._func == b._func;
+    }
+
+    template <typename TObject>
+    static size_t _CallableHash(const _MemberFunctionWrapper<TObject> &callable)
+    {
+        return std::hash<const void *>()(callable._pObj);
+    }
+
+    template <typename TObject>
+    static bool _CallableEquals(const _ConstMemberFunctionWrapper<TObject> &a, const _ConstMemberFunctionWrapper<TObject> &b)
+    {
+        return a._pObj == b._pObj && a._func == b._func;
+    }
+
+    template <typename TObject>
+    static size_t _CallableHash(const _ConstMemberFunctionWrapper<TObject> &callable)
+    {
+        return std::hash<const void *>()(callable._pObj);
+    }
+
+    template <_FunctionPointer Func>
+    static bool _CallableEquals(const _FunctionBinding<Func> &, const _FunctionBinding<Func> &)
+    {
+        return true;
+    }
+
+    template <_FunctionPointer Func>
+    static size_t _CallableHash(const _FunctionBinding<Func> &)
+    {
+        return 0;
+    }
+
+    template <typename TObject, typename TMethod, TMethod Method>
+    static bool _CallableEquals(const _MethodBinding<TObject, TMethod, Method> &a, const _MethodBinding<TObject, TMethod, Method> &b)
+    {
+        return a._pObj == b._pObj;
+    }
+
+    template <typename TObject, typename TMethod, TMethod Method>
+    static size_t _CallableHash(const _MethodBinding<TObject, TMethod, Method> &callable)
+    {
+        return std::hash<const void *>()(callable._pObj);
+    }
+};
+
+// Layout of an entry of a delegate invocation list, see Delegate::_Callable.
+struct _DelegateEntryLayout {
+    void (*invoke)();
+    const void *manager;
+    union {
+        void *ptr;
+        alignas(std::max_align_t) char buf[4 * sizeof(void *)];
+    } storage;
+};
+
+// The inline invocation list of a delegate with room for Count callables, see Delegate::_InlineItems.
+template <size_t Count, typename = void>
+struct _DelegateInlineList {
+    alignas(_DelegateEntryLayout) char _inlineBuf[Count * sizeof(_DelegateEntryLayout)];
+    uint32_t _inlineCount      = 0;
+    uint32_t _inlineNonTrivial = 0;
+    // Raises in progress over the inline callables, and the callables they keep in place after a
+    // change moved the invocation list to the heap, see Delegate::_RaiseScope.
+    mutable std::atomic<uint32_t> _inlineRaises{0};
+    uint32_t _inlinePinned = 0;
+
+    void _EnterInlineRaise() const
+    {
+        _inlineRaises.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Returns whether this was the last raise in progress.
+    bool _LeaveInlineRaise() const
+    {
+        return _inlineRaises.fetch_sub(1, std::memory_order_relaxed) == 1;
+    }
+    bool _InlineRaising() const
+    {
+        return _inlineRaises.load(std::memory_order_relaxed) != 0;
+    }
+};
+
+// Delegates without inline callables have no inline state, their inline list is always empty.
+template <typename T>
+struct _DelegateInlineList<0, T> {
+    struct _Zero {
+        operator size_t() const
+        {
+            return 0;
+        }
+        _Zero &operator=(size_t)
+        {
+            return *this;
+        }
+        _Zero &operator+=(size_t)
+        {
+            return *this;
+        }
+        _Zero &operator++()
+        {
+            return *this;
+        }
+        _Zero &operator--()
+        {
+            return *this;
+        }
+    };
+    static _DelegateEntryLayout _inlineBuf[1];
+    static _Zero _inlineCount;
+    static _Zero _inlineNonTrivial;
+    static _Zero _inlinePinned;
+
+    void _EnterInlineRaise() const
+    {
+    }
+    bool _LeaveInlineRaise() const
+    {
+        return false;
+    }
+    bool _InlineRaising() const
+    {
+        return false;
+    }
+};
+
+template <typename T>
+_DelegateEntryLayout _DelegateInlineList<0, T>::_inlineBuf[1];
+template <typename T>
+typename _DelegateInlineList<0, T>::_Zero _DelegateInlineList<0, T>::_inlineCount;
+template <typename T>
+typename _DelegateInlineList<0, T>::_Zero _DelegateInlineList<0, T>::_inlineNonTrivial;
+template <typename T>
+typename _DelegateInlineList<0, T>::_Zero _DelegateInlineList<0, T>::_inlinePinned;
+
+// The allocator of a delegate, empty allocators are default constructed when needed and take no space.
+template <typename TAllocator, typename = void>
+struct _DelegateAllocator {
+    TAllocator _allocator;
+
+    explicit _DelegateAllocator(const TAllocator &allocator)
+        : _allocator(allocator)
+    {
+    }
+    TAllocator _GetAllocator() const
+    {
+        return _allocator;
+    }
+    // Allocators need not be assignable, e.g. std::pmr::polymorphic_allocator.
+    void _SetAllocator(const TAllocator &allocator)
+    {
+        _allocator.~TAllocator();
+        new (&_allocator) TAllocator(allocator);
+    }
+};
+
+template <typename TAllocator>
+struct _DelegateAllocator<TAllocator, typename std::enable_if<std::is_empty<TAllocator>::value &&
+                                                              std::is_default_constructible<TAllocator>::value>::type> {
+    explicit _DelegateAllocator(const TAllocator &)
+    {
+    }
+    TAllocator _GetAllocator() const
+    {
+        return TAllocator();
+    }
+    void _SetAllocator(const TAllocator &)
+    {
+    }
+};
+
+template <typename, size_t InlineCount = 1, typename TAllocator = std::allocator<char>>
 class Delegate;
 
-template <typename TRet, typename... Args>
-class Delegate<TRet(Args...)> final
-{
+// InlineCount is the number of callables stored in the delegate object itself before
+// the invocation list spills to the heap. With InlineCount 0 the delegate is the size of a pointer,
+// which is null while it is empty, see CompactDelegate. Since C++17 the signature may be noexcept, e.g.
+// Delegate<void(int) noexcept>, such delegates only accept callables that are noexcept and
+// are invoked without exception handling. Callables that cannot be copied, e.g. lambdas capturing a
+// std::unique_ptr, are stored in a reference counted box, copies of the delegate share them.
+//
+// TAllocator allocates the heap invocation list and the callables that are not stored inline, e.g.
+// std::pmr::polymorphic_allocator<char> to allocate from a memory resource, see PmrDelegate. Copies and moves
+// share the invocation list of their source, so they also take its allocator; use the copy constructor taking
+// an allocator to copy into another one. Callables copied from another delegate, e.g. by Append, are allocated
+// with the allocator of the delegate they are copied into, except callables that cannot be copied, they are
+// shared and freed with the allocator they were created with.
+#if _DELEGATE_CPLUSPLUS >= 201703L
+template <typename TRet, typename... Args, size_t InlineCount, typename TAllocator, bool NoExcept>
+class Delegate<TRet(Args...) noexcept(NoExcept), InlineCount, TAllocator> final : private _DelegateInlineList<InlineCount>,
+                                                                                  private _DelegateAllocator<TAllocator>
+#else
+template <typename TRet, typename... Args, size_t InlineCount, typename TAllocator>
+class Delegate<TRet(Args...), InlineCount, TAllocator> final : private _DelegateInlineList<InlineCount>,
+                                                               private _DelegateAllocator<TAllocator>
+#endif
+{
+private:
+    using _DelegateInlineList<InlineCount>::_inlineBuf;
+    using _DelegateInlineList<InlineCount>::_inlineCount;
+    using _DelegateInlineList<InlineCount>::_inlineNonTrivial;
+    using _DelegateInlineList<InlineCount>::_inlinePinned;
+    using _DelegateInlineList<InlineCount>::_EnterInlineRaise;
+    using _DelegateInlineList<InlineCount>::_LeaveInlineRaise;
+    using _DelegateInlineList<InlineCount>::_InlineRaising;
+    using _DelegateAllocator<TAllocator>::_GetAllocator;
+    using _DelegateAllocator<TAllocator>::_SetAllocator;
+
+    template <typename T>
+    using _Allocator = typename std::allocator_traits<TAllocator>::template rebind_alloc<T>;
+
+    template <typename T>
+    using _AllocatorTraits = std::allocator_traits<_Allocator<T>>;
+
+    // Allocates and constructs a T with allocator, the memory is freed if the constructor throws.
+    template <typename T, typename... TArgs>
+    static T *_New(const TAllocator &allocator, TArgs &&...args)
+    {
+        _Allocator<T> typed(allocator);
+        T *memory = _AllocatorTraits<T>::allocate(typed, 1);
+        std::unique_ptr<T, _Deallocator<T>> guard(memory, _Deallocator<T>(typed));
+        new (memory) T(std::forward<TArgs>(args)...);
+        return guard.release();
+    }
+
+    template <typename T>
+    static void _Delete(const TAllocator &allocator, T *value)
+    {
+        _Allocator<T> typed(allocator);
+        value->~T();
+        _AllocatorTraits<T>::deallocate(typed, value, 1);
+    }
+
+    template <typename T>
+    struct _Deallocator : _DelegateAllocator<_Allocator<T>> {
+        explicit _Deallocator(const _Allocator<T> &allocator)
+            : _DelegateAllocator<_Allocator<T>>(allocator)
+        {
+        }
+        void operator()(T *memory)
+        {
+            _Allocator<T> allocator = this->_GetAllocator();
+            _AllocatorTraits<T>::deallocate(allocator, memory, 1);
+        }
+    };
+
+    template <typename T>
+    struct _Deleter : _DelegateAllocator<TAllocator> {
+        explicit _Deleter(const TAllocator &allocator)
+            : _DelegateAllocator<TAllocator>(allocator)
+        {
+        }
+        void operator()(T *value) const
+        {
+            _Delete(this->_GetAllocator(), value);
+        }
+    };
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _Signature = _DelegateSignature<TRet(Args...) noexcept(NoExcept)>;
+#else
+    using _Signature = _DelegateSignature<TRet(Args...)>;
+#endif
+
+    static constexpr bool _NoExcept = _Signature::_NoExcept;
+
+    using _FunctionPointer = typename _Signature::_FunctionPointer;
+
+    template <typename TObject>
+    using _MethodPointer = typename _Signature::template _MethodPointer<TObject>;
+
+    template <typename TObject>
+    using _ConstMethodPointer = typename _Signature::template _ConstMethodPointer<TObject>;
+
+    // Size of the inline storage of a callable, large enough for a function pointer,
+    // a bound member function or a lambda with a few captures. Larger callables are stored on the heap.
+    static constexpr size_t _InlineSize = 4 * sizeof(void *);
+
+    template <typename T>
+    struct _FitsInline : std::integral_constant<bool,
+                                                sizeof(T) <= _InlineSize &&
+                                                    alignof(T) <= alignof(std::max_align_t) &&
+                                                    std::is_nothrow_move_constructible<T>::value> {
+    };
+
+    // Trivial callables, e.g. function pointers, bound member functions and lambdas capturing only
+    // trivially copyable values, are copied with memcpy and need no destruction.
+    template <typename T>
+    struct _IsTrivial : std::integral_constant<bool,
+                                               _FitsInline<T>::value &&
+                                                   std::is_copy_constructible<T>::value &&
+                                                   std::is_trivially_copyable<T>::value &&
+                                                   std::is_trivially_destructible<T>::value> {
+    };
+
+    // Stateless callables, e.g. captureless lambdas, are compared by type only. Their manager has no
+    // equals and hash functions, so comparing two of them is a pointer comparison.
+    template <typename T, typename = void>
+    struct _IsStateless : std::false_type {
+    };
+
+    template <typename T>
+    struct _IsStateless<T, typename std::enable_if<DelegateCallableTraits<T>::_AllEqual::value>::type> : _IsTrivial<T> {
+    };
+
+    union _Storage {
+        void *ptr;
+        alignas(std::max_align_t) char buf[_InlineSize];
+    };
+
+    template <typename A>
+    using _ArgRef = typename _Signature::template _ArgRef<A>;
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _InvokeFunc = TRet (*)(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args) noexcept(NoExcept);
+#else
+    using _InvokeFunc = TRet (*)(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args);
+#endif
+
+    // Operations of a stored callable that are not needed to invoke it,
+    // copy, move and destroy are null for trivial callables. There is one constant manager per
+    // callable type, its address identifies the type without RTTI.
+    struct _Manager {
+        void (*copy)(_Storage &dst, const _Storage &src, const TAllocator &allocator);
+        void (*move)(_Storage &dst, _Storage &src); // src is destroyed
+        void (*destroy)(_Storage &storage);
+        bool (*equals)(const _Storage &a, const _Storage &b); // null if all callables of the type are equal
+        size_t (*hash)(const _Storage &storage);              // equal callables have equal hashes, null for 0
+    };
+
+    template <typename TObject>
+    using _MemberFunctionWrapper = typename _Signature::template _MemberFunctionWrapper<TObject>;
+
+    template <typename TObject>
+    using _ConstMemberFunctionWrapper = typename _Signature::template _ConstMemberFunctionWrapper<TObject>;
+
+    template <_FunctionPointer Func>
+    using _FunctionBinding = typename _Signature::template _FunctionBinding<Func>;
+
+    template <typename TObject, typename TMethod, TMethod Method>
+    using _MethodBinding = typename _Signature::template _MethodBinding<TObject, TMethod, Method>;
+
+    // Nested delegates are compared by their invocation lists, other callables as in _DelegateSignature.
+    template <typename T>
+    static bool _CallableEquals(const T &a, const T &b)
+    {
+        return _Signature::_CallableEquals(a, b);
+    }
+
+    template <typename T>
+    static size_t _CallableHash(const T &callable)
+    {
+        return _Signature::_CallableHash(callable);
+    }
+
+    static bool _CallableEquals(const Delegate &a, const Delegate &b)
+    {
+        return a == b;
+    }
+
+    static size_t _CallableHash(const Delegate &callable)
+    {
+        return callable.GetHashCode();
+    }
+
+    // Trivially copyable callables are copied with memcpy, keeping their padding bytes for bytewise comparison.
+    template <typename T, typename... TArgs>
+    struct _IsBytewiseCopy : std::false_type {
+    };
+
+    template <typename T, typename TArg>
+    struct _IsBytewiseCopy<T, TArg> : std::integral_constant<bool,
+                                                             std::is_trivially_copyable<T>::value &&
+                                                                 std::is_same<typename std::decay<TArg>::type, T>::value> {
+    };
+
+    template <typename T>
+    static void _Construct(void *buf, std::true_type, const T &callable)
+    {
+        memcpy(buf, &callable, sizeof(T));
+    }
+
+    template <typename T, typename... TArgs>
+    static void _Construct(void *buf, std::false_type, TArgs &&...args)
+    {
+        new (buf) T(std::forward<TArgs>(args)...);
+    }
+
+    template <typename T>
+    struct _InlineStorage {
+        static T &Get(_Storage &storage)
+        {
+            return *reinterpret_cast<T *>(storage.buf);
+        }
+        static const T &Get(const _Storage &storage)
+        {
+            return *reinterpret_cast<const T *>(storage.buf);
+        }
+        template <typename... TArgs>
+        static void Create(_Storage &storage, const TAllocator &, TArgs &&...args)
+        {
+            _Construct<T>(storage.buf, _IsBytewiseCopy<T, TArgs...>(), std::forward<TArgs>(args)...);
+        }
+        static void Copy(_Storage &dst, const _Storage &src, const TAllocator &allocator)
+        {
+            Create(dst, allocator, Get(src));
+        }
+        static void Move(_Storage &dst, _Storage &src)
+        {
+            _Construct<T>(dst.buf, _IsBytewiseCopy<T, T>(), std::move(Get(src)));
+            Destroy(src);
+        }
+        static void Destroy(_Storage &storage)
+        {
+            Get(storage).~T();
+        }
+    };
+
+    // Boxes keep the allocator they were allocated with, so they can be freed without the delegate.
+    template <typename T>
+    struct _HeapStorage {
+        struct _Box : _DelegateAllocator<TAllocator> {
+            alignas(T) char buf[sizeof(T)];
+
+            explicit _Box(const TAllocator &allocator)
+                : _DelegateAllocator<TAllocator>(allocator)
+            {
+            }
+        };
+        static T &Get(_Storage &storage)
+        {
+            return *reinterpret_cast<T *>(static_cast<_Box *>(storage.ptr)->buf);
+        }
+        static const T &Get(const _Storage &storage)
+        {
+            return *reinterpret_cast<const T *>(static_cast<const _Box *>(storage.ptr)->buf);
+        }
+        template <typename... TArgs>
+        static void Create(_Storage &storage, const TAllocator &allocator, TArgs &&...args)
+        {
+            std::unique_ptr<_Box, _Deleter<_Box>> box(_New<_Box>(allocator, allocator), _Deleter<_Box>(allocator));
+            _Construct<T>(box->buf, _IsBytewiseCopy<T, TArgs...>(), std::forward<TArgs>(args)...);
+            storage.ptr = box.release();
+        }
+        static void Copy(_Storage &dst, const _Storage &src, const TAllocator &allocator)
+        {
+            Create(dst, allocator, Get(src));
+        }
+        static void Move(_Storage &dst, _Storage &src)
+        {
+            dst.ptr = src.ptr;
+        }
+        static void Destroy(_Storage &storage)
+        {
+            _Box *box = static_cast<_Box *>(storage.ptr);
+            Get(storage).~T();
+            _Delete(box->_GetAllocator(), box);
+        }
+    };
+
+    // Callables that cannot be copied are shared by the copies of the delegate.
+    template <typename T>
+    struct _SharedStorage {
+        struct _Box : _DelegateAllocator<TAllocator> {
+            std::atomic<size_t> refCount;
+            alignas(T) char buf[sizeof(T)];
+
+            explicit _Box(const TAllocator &allocator)
+                : _DelegateAllocator<TAllocator>(allocator), refCount(1)
+            {
+            }
+        };
+        static T &Get(_Storage &storage)
+        {
+            return *reinterpret_cast<T *>(static_cast<_Box *>(storage.ptr)->buf);
+        }
+        static const T &Get(const _Storage &storage)
+        {
+            return *reinterpret_cast<const T *>(static_cast<const _Box *>(storage.ptr)->buf);
+        }
+        template <typename... TArgs>
+        static void Create(_Storage &storage, const TAllocator &allocator, TArgs &&...args)
+        {
+            std::unique_ptr<_Box, _Deleter<_Box>> box(_New<_Box>(allocator, allocator), _Deleter<_Box>(allocator));
+            new (box->buf) T(std::forward<TArgs>(args)...);
+            storage.ptr = box.release();
+        }
+        static void Copy(_Storage &dst, const _Storage &src, const TAllocator &)
+        {
+            static_cast<_Box *>(src.ptr)->refCount.fetch_add(1, std::memory_order_relaxed);
+            dst.ptr = src.ptr;
+        }
+        static void Move(_Storage &dst, _Storage &src)
+        {
+            dst.ptr = src.ptr;
+        }
+        static void Destroy(_Storage &storage)
+        {
+            _Box *box = static_cast<_Box *>(storage.ptr);
+            if (box->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                Get(storage).~T();
+                _Delete(box->_GetAllocator(), box);
+            }
+        }
+    };
+
+    template <typename T>
+    using _StorageOf = typename std::conditional<
+        !std::is_copy_constructible<T>::value, _SharedStorage<T>,
+        typename std::conditional<_FitsInline<T>::value, _InlineStorage<T>, _HeapStorage<T>>::type>::type;
+
+    template <typename T>
+    struct _CallableOps : _StorageOf<T> {
+        using _Base = _StorageOf<T>;
+        static TRet Invoke(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args) noexcept(_NoExcept)
+        {
+            return _Signature::_Invoke(_Base::Get(storage), forwardArgs, args...);
+        }
+        static bool Equals(const _Storage &a, const _Storage &b)
+        {
+            return _CallableEquals(_Base::Get(a), _Base::Get(b));
+        }
+        static size_t Hash(const _Storage &storage)
+        {
+            return _CallableHash(_Base::Get(storage));
+        }
+        static const _Manager *GetManager()
+        {
+            static const _Manager manager = {
+                _IsTrivial<T>::value ? nullptr : &_Base::Copy,
+                _IsTrivial<T>::value ? nullptr : &_Base::Move,
+                _IsTrivial<T>::value ? nullptr : &_Base::Destroy,
+                _IsStateless<T>::value ? nullptr : &Equals,
+                _IsStateless<T>::value ? nullptr : &Hash,
+            };
+            return &manager;
+        }
+    };
+
+    // Manager of the entries removed from a heap invocation list, see _FuncList::Kill.
+    static bool _RemovedEquals(const _Storage &, const _Storage &)
+    {
+        return false;
+    }
+
+    static const _Manager *_RemovedManager()
+    {
+        static const _Manager manager = {nullptr, nullptr, nullptr, &_RemovedEquals, nullptr};
+        return &manager;
+    }
+
+    // Equal callables have equal fingerprints. Fingerprints are odd, removed entries have fingerprint 0.
+    static uint64_t _Fingerprint(const _Manager *manager, size_t hash)
+    {
+        return ((static_cast<uint64_t>(reinterpret_cast<uintptr_t>(manager)) * 0x9E3779B97F4A7C15ull) ^ hash) | 1;
+    }
+
+    template <typename T>
+    static uint64_t _Fingerprint(const T &callable)
+    {
+        return _Fingerprint(_CallableOps<T>::GetManager(), _CallableHash(callable));
+    }
+
+    template <typename T>
+    struct _TypeTag {
+    };
+
+    template <typename T>
+    using _StoredType = typename _Signature::template _StoredType<T>;
+
+    // An entry of the invocation list. The invocation thunk and the state of the callable are stored
+    // together, so invoking a list is a linear scan with one indirect call per callable.
+    struct _Callable {
+        _InvokeFunc invoke;
+        const _Manager *manager;
+        _Storage storage;
+
+        template <typename T, typename... TArgs>
+        _Callable(_TypeTag<T>, const TAllocator &allocator, TArgs &&...args)
+            : invoke(&_CallableOps<T>::Invoke), manager(_CallableOps<T>::GetManager())
+        {
+            _CallableOps<T>::Create(storage, allocator, std::forward<TArgs>(args)...);
+        }
+        // A removed entry, it has no invocation thunk and never equals another callable.
+        _Callable() noexcept
+            : invoke(nullptr), manager(_RemovedManager())
+        {
+            storage.ptr = nullptr;
+        }
+        // Callables stored on the heap are copied with allocator.
+        _Callable(const _Callable &other, const TAllocator &allocator)
+            : invoke(other.invoke), manager(other.manager)
+        {
+            if (manager->copy) {
+                manager->copy(storage, other.storage, allocator);
+            } else {
+                storage = other.storage;
+            }
+        }
+        _Callable(_Callable &&other) noexcept
+            : invoke(other.invoke), manager(other.manager)
+        {
+            if (manager->move) {
+                manager->move(storage, other.storage);
+            } else {
+                storage = other.storage;
+            }
+            other.manager = nullptr;
+        }
+        ~_Callable()
+        {
+            if (manager && manager->destroy) {
+                manager->destroy(storage);
+            }
+        }
+        bool IsTrivial() const
+        {
+            return manager->copy == nullptr;
+        }
+        bool IsRemoved() const
+        {
+            return invoke == nullptr;
+        }
+        bool Equals(const _Callable &other) const
+        {
+            return manager == other.manager && (manager->equals == nullptr || manager->equals(storage, other.storage));
+        }
+        // Compares with a callable that has not been added, without copying it.
+        template <typename T>
+        bool Matches(const T &callable) const
+        {
+            return manager == _CallableOps<T>::GetManager() &&
+                   (_IsStateless<T>::value || _CallableEquals(_CallableOps<T>::Get(storage), callable));
+        }
+        uint64_t Fingerprint() const
+        {
+            return _Fingerprint(manager, manager->hash ? manager->hash(storage) : 0);
+        }
+    };
+
+    // Copies callables to uninitialized memory, dstCount and dstNonTrivial are incremented for each copied
+    // callable, so they describe the copies made so far if a copy throws.
+    template <typename TCount>
+    static void _CopyItems(_Callable *dst, TCount &dstCount, TCount &dstNonTrivial, const _Callable *src, size_t count, bool trivial, const TAllocator &allocator)
+    {
+        if (trivial) {
+            memcpy(static_cast<void *>(dst + dstCount), src, count * sizeof(_Callable));
+            dstCount += count;
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                const _Callable *item = new (dst + dstCount) _Callable(src[i], allocator);
+                ++dstCount;
+                if (!item->IsTrivial()) {
+                    ++dstNonTrivial;
+                }
+            }
+        }
+    }
+
+    // Moves callables to uninitialized memory, the source callables are destroyed.
+    static void _RelocateItems(_Callable *dst, _Callable *src, size_t count, bool trivial) noexcept
+    {
+        if (trivial) {
+            memmove(static_cast<void *>(dst), src, count * sizeof(_Callable));
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                new (dst + i) _Callable(std::move(src[i]));
+                src[i].~_Callable();
+            }
+        }
+    }
+
+    static void _DestroyItems(_Callable *items, size_t count, bool trivial)
+    {
+        if (!trivial) {
+            for (size_t i = 0; i < count; ++i) {
+                items[i].~_Callable();
+            }
+        }
+    }
+
+    template <typename TCount>
+    static void _EraseItem(_Callable *items, TCount &count, TCount &nonTrivialCount, size_t index)
+    {
+        if (!items[index].IsTrivial()) {
+            --nonTrivialCount;
+        }
+        items[index].~_Callable();
+        _RelocateItems(items + index, items + index + 1, count - index - 1, nonTrivialCount == 0);
+        --count;
+    }
+
+    // Generational slot map from handles to positions in a heap invocation list, it is created
+    // when the first callable is added with a handle. A slot is reused with a new id once its
+    // callable has been removed, so stale handles are detected.
+    struct _SlotMap {
+        enum : size_t { _NoSlot = ~size_t(0) };
+
+        struct _Slot {
+            uint64_t id;  // 0 while the slot is free
+            size_t index; // position of the callable, or the next free slot while the slot is free
+        };
+
+        std::vector<_Slot, _Allocator<_Slot>> slots;
+        std::vector<size_t, _Allocator<size_t>> itemSlots; // slot of each callable, _NoSlot if it was added without a handle
+        size_t freeSlot = _NoSlot;
+
+        explicit _SlotMap(const TAllocator &allocator)
+            : slots(_Allocator<_Slot>(allocator)), itemSlots(_Allocator<size_t>(allocator))
+        {
+        }
+        _SlotMap(const _SlotMap &other, const TAllocator &allocator)
+            : slots(other.slots, _Allocator<_Slot>(allocator)), itemSlots(other.itemSlots, _Allocator<size_t>(allocator)), freeSlot(other.freeSlot)
+        {
+        }
+
+        // Makes sure that the next Acquire does not allocate.
+        void Reserve()
+        {
+            if (freeSlot == _NoSlot) {
+                slots.push_back({0, _NoSlot});
+                freeSlot = slots.size() - 1;
+            }
+        }
+        DelegateHandle Acquire(size_t index)
+        {
+            DelegateHandle handle;
+            handle.id          = DelegateHandle::_NextId();
+            handle.slot        = static_cast<uint32_t>(freeSlot);
+            freeSlot           = slots[handle.slot].index;
+            slots[handle.slot] = {handle.id, index};
+            itemSlots[index]   = handle.slot;
+            return handle;
+        }
+        void Release(size_t index)
+        {
+            size_t slot = itemSlots[index];
+            if (slot != _NoSlot) {
+                slots[slot]      = {0, freeSlot};
+                freeSlot         = slot;
+                itemSlots[index] = _NoSlot;
+            }
+        }
+        bool Find(const DelegateHandle &handle, size_t &index) const
+        {
+            if (handle.id == 0 || handle.slot >= slots.size() || slots[handle.slot].id != handle.id) {
+                return false;
+            }
+            index = slots[handle.slot].index;
+            return true;
+        }
+    };
+
+    // Heap invocation list shared between copies of a delegate, it is never modified while shared.
+    // The callables are stored right after the header in the same allocation, followed by their
+    // fingerprints which are scanned before comparing callables for equality. Removed callables
+    // leave an entry without thunk behind, these are skipped by invocation and compacted once they
+    // make up half of the list. The last entry is never a removed one.
+    struct alignas(alignof(_Callable)) _FuncList {
+        std::atomic<size_t> refCount;
+        size_t count;
+        size_t capacity;
+        size_t nonTrivialCount;
+        size_t removedCount;
+        _SlotMap *slotMap;
+
+        explicit _FuncList(size_t capacity)
+            : refCount(1), count(0), capacity(capacity), nonTrivialCount(0), removedCount(0), slotMap(nullptr)
+        {
+        }
+        _Callable *Items()
+        {
+            return reinterpret_cast<_Callable *>(this + 1);
+        }
+        const _Callable *Items() const
+        {
+            return reinterpret_cast<const _Callable *>(this + 1);
+        }
+        uint64_t *Fingerprints()
+        {
+            return reinterpret_cast<uint64_t *>(Items() + capacity);
+        }
+        const uint64_t *Fingerprints() const
+        {
+            return reinterpret_cast<const uint64_t *>(Items() + capacity);
+        }
+        // Constructs the entry in place, the list is unchanged if the construction throws.
+        template <typename... TArgs>
+        void EmplaceBack(TArgs &&...args)
+        {
+            if (slotMap) {
+                slotMap->itemSlots.reserve(capacity);
+            }
+            _Callable *item = new (Items() + count) _Callable(std::forward<TArgs>(args)...);
+            if (slotMap) {
+                slotMap->itemSlots.push_back(_SlotMap::_NoSlot);
+            }
+            if (!item->IsTrivial()) {
+                ++nonTrivialCount;
+            }
+            Fingerprints()[count++] = item->Fingerprint();
+        }
+        // Removes the callable at index in amortized constant time without moving the other callables.
+        void Kill(size_t index)
+        {
+            _Callable *items = Items();
+            if (!items[index].IsTrivial()) {
+                --nonTrivialCount;
+            }
+            items[index].~_Callable();
+            new (items + index) _Callable();
+            Fingerprints()[index] = 0;
+            ++removedCount;
+            if (slotMap) {
+                slotMap->Release(index);
+            }
+            while (count != 0 && items[count - 1].IsRemoved()) {
+                --count;
+                --removedCount;
+            }
+            if (slotMap) {
+                slotMap->itemSlots.resize(count);
+            }
+            if (removedCount * 2 > count) {
+                Compact();
+            }
+        }
+        // Drops the removed entries, keeping the order of the callables.
+        void Compact()
+        {
+            _Callable *items       = Items();
+            uint64_t *fingerprints = Fingerprints();
+            size_t kept            = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (items[i].IsRemoved()) {
+                    continue;
+                }
+                if (kept != i) {
+                    new (items + kept) _Callable(std::move(items[i]));
+                    items[i].~_Callable();
+                    fingerprints[kept] = fingerprints[i];
+                    if (slotMap) {
+                        size_t slot              = slotMap->itemSlots[i];
+                        slotMap->itemSlots[kept] = slot;
+                        if (slot != _SlotMap::_NoSlot) {
+                            slotMap->slots[slot].index = kept;
+                        }
+                    }
+                }
+                ++kept;
+            }
+            count        = kept;
+            removedCount = 0;
+            if (slotMap) {
+                slotMap->itemSlots.resize(count);
+            }
+        }
+        // The list is allocated as an array of headers that is large enough for the items and fingerprints.
+        static size_t Blocks(size_t capacity)
+        {
+            return (2 * sizeof(_FuncList) - 1 + capacity * (sizeof(_Callable) + sizeof(uint64_t))) / sizeof(_FuncList);
+        }
+        static _FuncList *Create(const TAllocator &allocator, size_t capacity)
+        {
+            _Allocator<_FuncList> typed(allocator);
+            return new (_AllocatorTraits<_FuncList>::allocate(typed, Blocks(capacity))) _FuncList(capacity);
+        }
+        static void Destroy(const TAllocator &allocator, _FuncList *list)
+        {
+            _DestroyItems(list->Items(), list->count, list->nonTrivialCount == 0);
+            if (list->slotMap) {
+                _Delete(allocator, list->slotMap);
+            }
+            size_t blocks = Blocks(list->capacity);
+            list->~_FuncList();
+            _Allocator<_FuncList> typed(allocator);
+            _AllocatorTraits<_FuncList>::deallocate(typed, list, blocks);
+        }
+    };
+
+    struct _FuncListDeleter : _DelegateAllocator<TAllocator> {
+        explicit _FuncListDeleter(const TAllocator &allocator)
+            : _DelegateAllocator<TAllocator>(allocator)
+        {
+        }
+        void operator()(_FuncList *list) const
+        {
+            _FuncList::Destroy(this->_GetAllocator(), list);
+        }
+    };
+
+    // Keeps the invocation list of a raise alive and in place until the raise ends, so the callables may
+    // change the delegate. A heap list is shared with the raise and copied by the changes, inline callables
+    // are pinned: changes leave them in _inlineBuf and move the invocation list to the heap, see _Spill.
+    class _RaiseScope : private _FuncListDeleter {
+    public:
+        const _Callable *items;
+        size_t count;
+
+        explicit _RaiseScope(const Delegate &delegate)
+            : _FuncListDeleter(delegate._GetAllocator()), _delegate(delegate), _funcs(delegate._funcs)
+        {
+            if (_funcs) {
+                _funcs->refCount.fetch_add(1, std::memory_order_relaxed);
+                items = _funcs->Items();
+                count = _funcs->count;
+            } else {
+                delegate._EnterInlineRaise();
+                items = delegate._InlineItems();
+                count = delegate._inlineCount;
+            }
+        }
+        _RaiseScope(const _RaiseScope &)            = delete;
+        _RaiseScope &operator=(const _RaiseScope &) = delete;
+        ~_RaiseScope()
+        {
+            if (_funcs) {
+                if (_funcs->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    (*this)(_funcs);
+                }
+            } else if (_delegate._LeaveInlineRaise() && _delegate._inlinePinned != 0) {
+                // Only changes made during the raise pin callables, so the delegate is not const.
+                const_cast<Delegate &>(_delegate)._UnpinInline();
+            }
+        }
+
+    private:
+        const Delegate &_delegate;
+        _FuncList *_funcs;
+    };
+
+    // Returns the position of the first fingerprint equal to fingerprint in [begin, end), or end.
+    static size_t _FindFingerprint(const uint64_t *fingerprints, size_t begin, size_t end, uint64_t fingerprint)
+    {
+        size_t i = begin;
+#if defined(_DELEGATE_SSE2)
+        const __m128i needle = _mm_set1_epi64x(static_cast<long long>(fingerprint));
+        for (; i + 2 <= end; i += 2) {
+            // SSE2 has no 64-bit compare, both 32-bit halves have to match.
+            __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints + i)), needle);
+            equal         = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+            if (_mm_movemask_epi8(equal) != 0) {
+                break;
+            }
+        }
+#endif
+        while (i < end && fingerprints[i] != fingerprint) {
+            ++i;
+        }
+        return i;
+    }
+
+    // Returns the position of the last fingerprint equal to fingerprint in [0, end), or end.
+    static size_t _FindLastFingerprint(const uint64_t *fingerprints, size_t end, uint64_t fingerprint)
+    {
+        size_t i = end;
+#if defined(_DELEGATE_SSE2)
+        const __m128i needle = _mm_set1_epi64x(static_cast<long long>(fingerprint));
+        for (; i >= 2; i -= 2) {
+            __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints + i - 2)), needle);
+            equal         = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+            if (_mm_movemask_epi8(equal) != 0) {
+                break;
+            }
+        }
+#endif
+        for (; i > 0; --i) {
+            if (fingerprints[i - 1] == fingerprint) {
+                return i - 1;
+            }
+        }
+        return end;
+    }
+
+private:
+    static_assert(sizeof(_Callable) == sizeof(_DelegateEntryLayout) && alignof(_Callable) == alignof(_DelegateEntryLayout),
+                  "_DelegateEntryLayout must match _Callable");
+
+    // While _funcs is null, the first _inlineCount callables in _inlineBuf are the invocation list,
+    // once it grows beyond InlineCount all of them are moved to _funcs. _funcs is never an empty list.
+    _FuncList *_funcs = nullptr;
+
+public:
+    // Returned by IndexOf if there is no equal callable.
+    static constexpr size_t npos = ~size_t(0);
+
+    Delegate(std::nullptr_t = nullptr)
+        : _DelegateAllocator<TAllocator>(TAllocator())
+    {
+    }
+
+    explicit Delegate(const TAllocator &allocator)
+        : _DelegateAllocator<TAllocator>(allocator)
+    {
+    }
+
+    Delegate(const Delegate &other)
+        : Delegate(other._GetAllocator())
+    {
+        _CopyFrom(other);
+    }
+
+    // Copies other using allocator. Unless the allocators are equal the callables are copied, and
+    // handles returned by other.AddWithHandle do not identify them, see Append.
+    Delegate(const Delegate &other, const TAllocator &allocator)
+        : Delegate(allocator)
+    {
+        if (allocator == other._GetAllocator()) {
+            _CopyFrom(other);
+        } else {
+            Append(other);
+        }
+    }
+
+    Delegate(Delegate &&other) noexcept
+        : Delegate(other._GetAllocator())
+    {
+        _MoveFrom(other);
+    }
+
+    ~Delegate()
+    {
+        Clear();
+    }
+
+    template <typename TCallableObject, typename = typename std::enable_if<!std::is_same<typename std::decay<TCallableObject>::type, Delegate>::value &&
+                                                                           !std::is_convertible<TCallableObject, TAllocator>::value>::type>
+    Delegate(TCallableObject &&callable)
+        : Delegate()
+    {
+        Add(std::forward<TCallableObject>(callable));
+    }
+
+    template <typename TObject>
+    Delegate(TObject &obj, _MethodPointer<TObject> func)
+        : Delegate()
+    {
+        Add(obj, func);
+    }
+
+    template <typename TObject>
+    Delegate(const TObject &obj, _ConstMethodPointer<TObject> func)
+        : Delegate()
+    {
+        Add(obj, func);
+    }
+
+    TAllocator GetAllocator() const
+    {
+        return _GetAllocator();
+    }
+
+    // Binds a function known at compile time, e.g. Bind<&func>().
+    // The result can be added to, removed from or converted to a delegate.
+    template <_FunctionPointer Func>
+    static _FunctionBinding<Func> Bind()
+    {
+        return _FunctionBinding<Func>();
+    }
+
+    // Binds a member function known at compile time, e.g. Bind<Foo, &Foo::Method>(foo).
+    template <typename TObject, _MethodPointer<TObject> Method>
+    static _MethodBinding<TObject, _MethodPointer<TObject>, Method> Bind(TObject &obj)
+    {
+        return {&obj};
+    }
+
+    template <typename TObject, _ConstMethodPointer<TObject> Method>
+    static _MethodBinding<const TObject, _ConstMethodPointer<TObject>, Method> Bind(const TObject &obj)
+    {
+        return {&obj};
+    }
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    // Binds a member function known at compile time, e.g. Bind<&Foo::Method>(foo).
+    template <auto Method, typename TObject>
+    static _MethodBinding<TObject, decltype(Method), Method> Bind(TObject &obj)
+    {
+        static_assert(std::is_member_function_pointer<decltype(Method)>::value, "Method must be a member function pointer");
+        return {&obj};
+    }
+#endif
+
+    // Invokes the callables in order and returns the result of the last one. All callables but the
+    // last receive arguments taken by value as const lvalues, so they are copied only by callables
+    // that take them by value or only accept rvalues; the last callable receives the arguments forwarded.
+    // The callables may change the delegate, the changes take effect from the next raise.
+    TRet operator()(Args... args) const noexcept(_NoExcept)
+    {
+        if (IsNull()) {
+            return _Signature::_InvokeEmpty(std::integral_constant<bool, _NoExcept>());
+        }
+        _RaiseScope raise(*this);
+        const _Callable *items = raise.items;
+        size_t count           = raise.count;
+        for (size_t i = 0; i < count - 1; ++i) {
+            if (!items[i].IsRemoved()) {
+                items[i].invoke(items[i].storage, false, args...);
+            }
+        }
+        return items[count - 1].invoke(items[count - 1].storage, true, args...);
+    }
+
+    TRet Invoke(Args... args) const noexcept(_NoExcept)
+    {
+        return (*this)(std::forward<Args>(args)...);
+    }
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    // Invokes the callables unless the delegate is empty, the empty delegate policy is not used.
+    // Returns the result of the last callable, or for void delegates whether anything was invoked.
+    typename std::conditional<std::is_void<TRet>::value, bool, std::optional<TRet>>::type TryInvoke(Args... args) const noexcept(_NoExcept)
+    {
+        if (IsNull()) {
+            return {};
+        }
+        if constexpr (std::is_void<TRet>::value) {
+            (*this)(std::forward<Args>(args)...);
+            return true;
+        } else {
+            return (*this)(std::forward<Args>(args)...);
+        }
+    }
+#endif
+
+    // Invokes all callables and writes their results to out in invocation order,
+    // returns the output iterator past the last result.
+    template <typename TOutputIt>
+    TOutputIt InvokeAll(TOutputIt out, Args... args) const
+    {
+        static_assert(!std::is_void<TRet>::value, "InvokeAll requires a non-void return type");
+        _RaiseScope raise(*this);
+        const _Callable *items = raise.items;
+        size_t count           = raise.count;
+        for (size_t i = 0; i < count; ++i) {
+            if (!items[i].IsRemoved()) {
+                *out = items[i].invoke(items[i].storage, i == count - 1, args...);
+                ++out;
+            }
+        }
+        return out;
+    }
+
+    // Invokes all callables and folds their results with acc = reducer(acc, result),
+    // returns init if the delegate is empty.
+    template <typename TAcc, typename TReducer>
+    TAcc Aggregate(TAcc init, TReducer reducer, Args... args) const
+    {
+        static_assert(!std::is_void<TRet>::value, "Aggregate requires a non-void return type");
+        _RaiseScope raise(*this);
+        const _Callable *items = raise.items;
+        size_t count           = raise.count;
+        for (size_t i = 0; i < count; ++i) {
+            if (!items[i].IsRemoved()) {
+                init = reducer(std::move(init), items[i].invoke(items[i].storage, i == count - 1, args...));
+            }
+        }
+        return init;
+    }
+
+    // Invokes the callables concurrently on pool and returns after all of them have finished, the order
+    // of invocation is unspecified. All callables share the arguments, none receives them forwarded, so
+    // the arguments must be copyable. Short lists are invoked on the calling thread, see
+    // DelegateThreadPool::GetInlineThreshold. Requires delegate_thread_pool.h.
+    void InvokeParallel(DelegateThreadPool &pool, Args... args) const
+    {
+        static_assert(std::is_void<TRet>::value, "InvokeParallel requires a void return type");
+        static_assert(_Signature::_CopyableArgs::value, "InvokeParallel requires arguments that can be copied");
+        _RaiseScope raise(*this);
+        const _Callable *items = raise.items;
+        auto body              = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!items[i].IsRemoved()) {
+                    items[i].invoke(items[i].storage, false, args...);
+                }
+            }
+        };
+        _ParallelFor(pool, raise.count, body);
+    }
+
+    // Invokes the callables concurrently on DelegateThreadPool::Default().
+    template <typename TPool = DelegateThreadPool>
+    void InvokeParallel(Args... args) const
+    {
+        InvokeParallel(TPool::Default(), args...);
+    }
+
+    Delegate &operator=(const Delegate &other)
+    {
+        if (this == &other) {
+            return *this;
+        }
+        Clear();
+        _CopyFrom(other);
+        return *this;
+    }
+
+    Delegate &operator=(Delegate &&other) noexcept
+    {
+        if (this != &other) {
+            Clear();
+            _MoveFrom(other);
+        }
+        return *this;
+    }
+
+    void Clear()
+    {
+        _DestroyInline();
+        _ReleaseFuncs();
+    }
+
+    Delegate &operator=(std::nullptr_t)
+    {
+        Clear();
+        return *this;
+    }
+
+    bool IsNull() const
+    {
+        return _funcs == nullptr && _inlineCount == 0;
+    }
+
+    bool operator==(std::nullptr_t) const
+    {
+        return IsNull();
+    }
+
+    bool operator!=(std::nullptr_t) const
+    {
+        return !IsNull();
+    }
+
+    // Adds a copy of the callable, or moves it if it is an rvalue.
+    template <typename TCallableObject>
+    void Add(TCallableObject &&callable)
+    {
+        _Add(_TypeTag<_StoredType<typename std::decay<TCallableObject>::type>>(), std::forward<TCallableObject>(callable));
+    }
+
+    void Add(_FunctionPointer ptr)
+    {
+        if (ptr) {
+            _Add(_TypeTag<_FunctionPointer>(), ptr);
+        }
+    }
+
+    void Add(std::nullptr_t)
+    {
+    }
+
+    template <typename TObject>
+    void Add(TObject &obj, _MethodPointer<TObject> func)
+    {
+        if (func) {
+            _Add(_TypeTag<_MemberFunctionWrapper<TObject>>(), obj, func);
+        }
+    }
+
+    template <typename TObject>
+    void Add(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        if (func) {
+            _Add(_TypeTag<_ConstMemberFunctionWrapper<TObject>>(), obj, func);
+        }
+    }
+
+    // Adds a callable of type T constructed from args in the invocation list, T is neither copied nor moved.
+    // args must not refer to this delegate.
+    template <typename T, typename... TArgs>
+    void Emplace(TArgs &&...args)
+    {
+        static_assert(std::is_same<T, typename std::decay<T>::type>::value, "T must be an object type");
+        _Add(_TypeTag<T>(), std::forward<TArgs>(args)...);
+    }
+
+    // Adds a callable and returns a handle that removes it in constant time, see Remove(DelegateHandle).
+    // The handle is also valid for copies of the delegate. Adding with a handle moves the invocation
+    // list to the heap.
+    template <typename TCallableObject>
+    DelegateHandle AddWithHandle(TCallableObject &&callable)
+    {
+        return _AddWithHandle(_TypeTag<_StoredType<typename std::decay<TCallableObject>::type>>(), std::forward<TCallableObject>(callable));
+    }
+
+    DelegateHandle AddWithHandle(_FunctionPointer ptr)
+    {
+        return ptr ? _AddWithHandle(_TypeTag<_FunctionPointer>(), ptr) : DelegateHandle();
+    }
+
+    DelegateHandle AddWithHandle(std::nullptr_t)
+    {
+        return DelegateHandle();
+    }
+
+    template <typename TObject>
+    DelegateHandle AddWithHandle(TObject &obj, _MethodPointer<TObject> func)
+    {
+        return func ? _AddWithHandle(_TypeTag<_MemberFunctionWrapper<TObject>>(), obj, func) : DelegateHandle();
+    }
+
+    template <typename TObject>
+    DelegateHandle AddWithHandle(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        return func ? _AddWithHandle(_TypeTag<_ConstMemberFunctionWrapper<TObject>>(), obj, func) : DelegateHandle();
+    }
+
+    // Adds the callables in [first, last) in order, the invocation list is grown once for forward iterators.
+    template <typename TIterator>
+    void AddRange(TIterator first, TIterator last)
+    {
+        _AddRange(first, last, typename std::iterator_traits<TIterator>::iterator_category());
+    }
+
+    // Appends the callables of other to the invocation list. Unlike Add(other), which adds other as a
+    // single callable, they are invoked directly and can be removed one by one. Handles returned by
+    // other.AddWithHandle do not identify the appended callables.
+    void Append(const Delegate &other)
+    {
+        if (&other == this) {
+            Append(Delegate(other));
+            return;
+        }
+        if (IsNull() && (other._funcs == nullptr || other._funcs->slotMap == nullptr) && _GetAllocator() == other._GetAllocator()) {
+            *this = other;
+            return;
+        }
+        _Reserve(other._LiveCount());
+        const _Callable *items = other._Items();
+        size_t count           = other._Count();
+        for (size_t i = 0; i < count; ++i) {
+            if (!items[i].IsRemoved()) {
+                _AddEntry(items[i], _GetAllocator());
+            }
+        }
+    }
+
+    // Returns a delegate that invokes the callables of this delegate and then those of other, see Append.
+    Delegate operator+(const Delegate &other) const
+    {
+        Delegate result(*this);
+        result.Append(other);
+        return result;
+    }
+
+    template <typename TCallableObject>
+    Delegate &operator+=(TCallableObject &&callable)
+    {
+        Add(std::forward<TCallableObject>(callable));
+        return *this;
+    }
+
+    Delegate &operator+=(_FunctionPointer ptr)
+    {
+        Add(ptr);
+        return *this;
+    }
+
+    Delegate &operator+=(std::nullptr_t)
+    {
+        return *this;
+    }
+
+    template <typename TCallableObject>
+    void Remove(const TCallableObject &callable)
+    {
+        _Remove(static_cast<const _StoredType<TCallableObject> &>(callable));
+    }
+
+    void Remove(_FunctionPointer ptr)
+    {
+        if (ptr) {
+            _Remove(ptr);
+        }
+    }
+
+    void Remove(std::nullptr_t)
+    {
+    }
+
+    // Removes the callable added with handle in amortized constant time,
+    // does nothing if it has already been removed.
+    void Remove(DelegateHandle handle)
+    {
+        size_t index;
+        if (_funcs == nullptr || _funcs->slotMap == nullptr || !_funcs->slotMap->Find(handle, index)) {
+            return;
+        }
+        _FuncList &funcs = _MutableFuncs(0);
+        funcs.Kill(index);
+        if (funcs.count == 0) {
+            _ReleaseFuncs();
+        }
+    }
+
+    template <typename TObject>
+    void Remove(TObject &obj, _MethodPointer<TObject> func)
+    {
+        if (func) {
+            _Remove(_MemberFunctionWrapper<TObject>(obj, func));
+        }
+    }
+
+    template <typename TObject>
+    void Remove(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        if (func) {
+            _Remove(_ConstMemberFunctionWrapper<TObject>(obj, func));
+        }
+    }
+
+    template <typename TCallableObject>
+    bool Contains(const TCallableObject &callable) const
+    {
+        return _Contains(static_cast<const _StoredType<TCallableObject> &>(callable));
+    }
+
+    bool Contains(_FunctionPointer ptr) const
+    {
+        return ptr && _Contains(ptr);
+    }
+
+    template <typename TObject>
+    bool Contains(TObject &obj, _MethodPointer<TObject> func) const
+    {
+        return func && _Contains(_MemberFunctionWrapper<TObject>(obj, func));
+    }
+
+    template <typename TObject>
+    bool Contains(const TObject &obj, _ConstMethodPointer<TObject> func) const
+    {
+        return func && _Contains(_ConstMemberFunctionWrapper<TObject>(obj, func));
+    }
+
+    // Returns the position of the first equal callable in invocation order, or npos.
+    template <typename TCallableObject>
+    size_t IndexOf(const TCallableObject &callable) const
+    {
+        return _IndexOf(static_cast<const _StoredType<TCallableObject> &>(callable));
+    }
+
+    size_t IndexOf(_FunctionPointer ptr) const
+    {
+        return ptr ? _IndexOf(ptr) : npos;
+    }
+
+    template <typename TObject>
+    size_t IndexOf(TObject &obj, _MethodPointer<TObject> func) const
+    {
+        return func ? _IndexOf(_MemberFunctionWrapper<TObject>(obj, func)) : npos;
+    }
+
+    template <typename TObject>
+    size_t IndexOf(const TObject &obj, _ConstMethodPointer<TObject> func) const
+    {
+        return func ? _IndexOf(_ConstMemberFunctionWrapper<TObject>(obj, func)) : npos;
+    }
+
+    // Returns the number of callables equal to callable.
+    template <typename TCallableObject>
+    size_t Count(const TCallableObject &callable) const
+    {
+        return _CountOf(static_cast<const _StoredType<TCallableObject> &>(callable));
+    }
+
+    size_t Count(_FunctionPointer ptr) const
+    {
+        return ptr ? _CountOf(ptr) : 0;
+    }
+
+    template <typename TObject>
+    size_t Count(TObject &obj, _MethodPointer<TObject> func) const
+    {
+        return func ? _CountOf(_MemberFunctionWrapper<TObject>(obj, func)) : 0;
+    }
+
+    template <typename TObject>
+    size_t Count(const TObject &obj, _ConstMethodPointer<TObject> func) const
+    {
+        return func ? _CountOf(_ConstMemberFunctionWrapper<TObject>(obj, func)) : 0;
+    }
+
+    // Adds the callable unless an equal one has already been added, returns whether it was added.
+    template <typename TCallableObject>
+    bool AddUnique(TCallableObject &&callable)
+    {
+        if (Contains(callable)) {
+            return false;
+        }
+        Add(std::forward<TCallableObject>(callable));
+        return true;
+    }
+
+    bool AddUnique(_FunctionPointer ptr)
+    {
+        if (ptr == nullptr || _Contains(ptr)) {
+            return false;
+        }
+        Add(ptr);
+        return true;
+    }
+
+    bool AddUnique(std::nullptr_t)
+    {
+        return false;
+    }
+
+    template <typename TObject>
+    bool AddUnique(TObject &obj, _MethodPointer<TObject> func)
+    {
+        if (func == nullptr || _Contains(_MemberFunctionWrapper<TObject>(obj, func))) {
+            return false;
+        }
+        Add(obj, func);
+        return true;
+    }
+
+    template <typename TObject>
+    bool AddUnique(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        if (func == nullptr || _Contains(_ConstMemberFunctionWrapper<TObject>(obj, func))) {
+            return false;
+        }
+        Add(obj, func);
+        return true;
+    }
+
+    template <typename TCallableObject>
+    Delegate &operator-=(const TCallableObject &callable)
+    {
+        Remove(callable);
+        return *this;
+    }
+
+    Delegate &operator-=(_FunctionPointer ptr)
+    {
+        Remove(ptr);
+        return *this;
+    }
+
+    Delegate &operator-=(std::nullptr_t)
+    {
+        return *this;
+    }
+
+    bool operator==(const Delegate &other) const
+    {
+        if (this == &other || (_funcs && _funcs == other._funcs)) {
+            return true;
+        }
+        if (_LiveCount() != other._LiveCount()) {
+            return false;
+        }
+        const _Callable *items      = _Items();
+        const _Callable *otherItems = other._Items();
+        for (size_t i = 0, j = 0; i < _Count(); ++i, ++j) {
+            // Removed entries only occur in heap lists, the live callables are compared pairwise.
+            while (items[i].IsRemoved()) {
+                ++i;
+            }
+            while (otherItems[j].IsRemoved()) {
+                ++j;
+            }
+            if (!items[i].Equals(otherItems[j])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const Delegate &other) const
+    {
+        return !(*this == other);
+    }
+
+    // Hash consistent with operator==, see DelegateCallableTraits.
+    size_t GetHashCode() const
+    {
+        const _Callable *items = _Items();
+        size_t count           = _Count();
+        uint64_t hash          = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t fingerprint = _funcs ? _funcs->Fingerprints()[i] : items[i].Fingerprint();
+            if (fingerprint != 0) {
+                hash = (hash ^ fingerprint) * 1099511628211ull;
+            }
+        }
+        return static_cast<size_t>(hash);
+    }
+
+private:
+    _Callable *_InlineItems()
+    {
+        return reinterpret_cast<_Callable *>(_inlineBuf);
+    }
+
+    const _Callable *_InlineItems() const
+    {
+        return reinterpret_cast<const _Callable *>(_inlineBuf);
+    }
+
+    const _Callable *_Items() const
+    {
+        return _funcs ? _funcs->Items() : _InlineItems();
+    }
+
+    // Number of entries including removed ones.
+    size_t _Count() const
+    {
+        return _funcs ? _funcs->count : _inlineCount;
+    }
+
+    size_t _LiveCount() const
+    {
+        return _funcs ? _funcs->count - _funcs->removedCount : _inlineCount;
+    }
+
+    // DelegateThreadPool is incomplete here, the call is resolved when InvokeParallel is instantiated.
+    template <typename TPool, typename TBody>
+    static void _ParallelFor(TPool &pool, size_t count, TBody &body)
+    {
+        pool.ParallelFor(count, body);
+    }
+
+    // Inline callables that a raise is iterating are pinned instead, see _RaiseScope.
+    void _DestroyInline()
+    {
+        if (_InlineRaising() && _inlineCount != 0) {
+            _inlinePinned = _inlineCount;
+        } else {
+            _DestroyItems(_InlineItems(), _inlineCount, _inlineNonTrivial == 0);
+        }
+        _inlineCount      = 0;
+        _inlineNonTrivial = 0;
+    }
+
+    // Destroys the pinned inline callables once the last raise over them has ended.
+    void _UnpinInline()
+    {
+        _DestroyItems(_InlineItems(), _inlinePinned, false);
+        _inlinePinned = 0;
+    }
+
+    void _ReleaseFuncs()
+    {
+        if (_funcs && _funcs->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            _FuncList::Destroy(_GetAllocator(), _funcs);
+        }
+        _funcs = nullptr;
+    }
+
+    // Returns the heap invocation list for modification with room for extra more callables,
+    // copying it first if it is shared. The positions of the callables do not change.
+    _FuncList &_MutableFuncs(size_t extra)
+    {
+        if (_funcs->refCount.load(std::memory_order_acquire) != 1) {
+            std::unique_ptr<_FuncList, _FuncListDeleter> funcs(_FuncList::Create(_GetAllocator(), _funcs->count + extra), _FuncListDeleter(_GetAllocator()));
+            _CopyItems(funcs->Items(), funcs->count, funcs->nonTrivialCount, _funcs->Items(), _funcs->count, _funcs->nonTrivialCount == 0, _GetAllocator());
+            memcpy(funcs->Fingerprints(), _funcs->Fingerprints(), _funcs->count * sizeof(uint64_t));
+            funcs->removedCount = _funcs->removedCount;
+            if (_funcs->slotMap) {
+                funcs->slotMap = _New<_SlotMap>(_GetAllocator(), *_funcs->slotMap, _GetAllocator());
+            }
+            _ReleaseFuncs();
+            _funcs = funcs.release();
+        } else if (_funcs->count + extra > _funcs->capacity) {
+            _FuncList *funcs = _FuncList::Create(_GetAllocator(), std::max(_funcs->capacity * 2, _funcs->count + extra));
+            _RelocateItems(funcs->Items(), _funcs->Items(), _funcs->count, _funcs->nonTrivialCount == 0);
+            memcpy(funcs->Fingerprints(), _funcs->Fingerprints(), _funcs->count * sizeof(uint64_t));
+            funcs->count           = _funcs->count;
+            funcs->nonTrivialCount = _funcs->nonTrivialCount;
+            funcs->removedCount    = _funcs->removedCount;
+            funcs->slotMap         = _funcs->slotMap;
+            _funcs->count          = 0;
+            _funcs->slotMap        = nullptr;
+            _FuncList::Destroy(_GetAllocator(), _funcs);
+            _funcs = funcs;
+        }
+        return *_funcs;
+    }
+
+    // Moves the inline callables to a heap invocation list with room for extra more, keeping the invocation order.
+    // While a raise is iterating them they are copied and pinned instead, see _RaiseScope.
+    void _Spill(size_t extra)
+    {
+        std::unique_ptr<_FuncList, _FuncListDeleter> funcs(_FuncList::Create(_GetAllocator(), std::max(InlineCount * 2, _inlineCount + extra)), _FuncListDeleter(_GetAllocator()));
+        if (_InlineRaising() && _inlineCount != 0) {
+            _CopyItems(funcs->Items(), funcs->count, funcs->nonTrivialCount, _InlineItems(), _inlineCount, _inlineNonTrivial == 0, _GetAllocator());
+            _inlinePinned = _inlineCount;
+        } else {
+            _RelocateItems(funcs->Items(), _InlineItems(), _inlineCount, _inlineNonTrivial == 0);
+            funcs->count           = _inlineCount;
+            funcs->nonTrivialCount = _inlineNonTrivial;
+        }
+        for (size_t i = 0; i < funcs->count; ++i) {
+            funcs->Fingerprints()[i] = funcs->Items()[i].Fingerprint();
+        }
+        _funcs            = funcs.release();
+        _inlineCount      = 0;
+        _inlineNonTrivial = 0;
+    }
+
+    // Copies and moves share the invocation list of other, so they take its allocator.
+    void _CopyFrom(const Delegate &other)
+    {
+        _SetAllocator(other._GetAllocator());
+        if (other._funcs == nullptr && _inlinePinned == 0) {
+            _CopyItems(_InlineItems(), _inlineCount, _inlineNonTrivial, other._InlineItems(), other._inlineCount, other._inlineNonTrivial == 0, _GetAllocator());
+            return;
+        }
+        if (other._funcs == nullptr) {
+            for (size_t i = 0; i < other._inlineCount; ++i) {
+                _AddEntry(other._InlineItems()[i], _GetAllocator());
+            }
+            return;
+        }
+        _funcs = other._funcs;
+        _funcs->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void _MoveFrom(Delegate &other)
+    {
+        _SetAllocator(other._GetAllocator());
+        if (other._funcs == nullptr && other._inlineCount != 0 && (other._InlineRaising() || _inlinePinned != 0)) {
+            other._Spill(0);
+        }
+        if (other._funcs == nullptr) {
+            _RelocateItems(_InlineItems(), other._InlineItems(), other._inlineCount, other._inlineNonTrivial == 0);
+            _inlineCount            = other._inlineCount;
+            _inlineNonTrivial       = other._inlineNonTrivial;
+            other._inlineCount      = 0;
+            other._inlineNonTrivial = 0;
+            return;
+        }
+        _funcs       = other._funcs;
+        other._funcs = nullptr;
+    }
+
+    // Makes room for extra callables, so adding them allocates at most once.
+    void _Reserve(size_t extra)
+    {
+        if (_funcs == nullptr) {
+            if (_inlineCount + extra <= InlineCount) {
+                return;
+            }
+            _Spill(extra);
+        }
+        _MutableFuncs(extra);
+    }
+
+    template <typename TIterator>
+    void _AddRange(TIterator first, TIterator last, std::input_iterator_tag)
+    {
+        for (; first != last; ++first) {
+            Add(*first);
+        }
+    }
+
+    template <typename TIterator>
+    void _AddRange(TIterator first, TIterator last, std::forward_iterator_tag)
+    {
+        _Reserve(static_cast<size_t>(std::distance(first, last)));
+        _AddRange(first, last, std::input_iterator_tag());
+    }
+
+    // Constructs a callable of type T from args in its entry of the invocation list. A delegate may be
+    // added to itself, so delegates are copied before the list is changed.
+    template <typename T, typename... TArgs>
+    void _Add(_TypeTag<T> tag, TArgs &&...args)
+    {
+        if (std::is_same<T, Delegate>::value) {
+            _AddEntry(_Callable(tag, _GetAllocator(), std::forward<TArgs>(args)...));
+        } else {
+            _AddEntry(tag, _GetAllocator(), std::forward<TArgs>(args)...);
+        }
+    }
+
+    template <typename... TArgs>
+    void _AddEntry(TArgs &&...args)
+    {
+        if (_funcs == nullptr) {
+            if (_inlineCount < InlineCount && _inlinePinned == 0) {
+                _Callable *item = new (&_InlineItems()[_inlineCount]) _Callable(std::forward<TArgs>(args)...);
+                if (!item->IsTrivial()) {
+                    ++_inlineNonTrivial;
+                }
+                ++_inlineCount;
+                return;
+            }
+            _Spill(1);
+        }
+        _MutableFuncs(1).EmplaceBack(std::forward<TArgs>(args)...);
+    }
+
+    template <typename T, typename... TArgs>
+    DelegateHandle _AddWithHandle(_TypeTag<T> tag, TArgs &&...args)
+    {
+        if (std::is_same<T, Delegate>::value) {
+            return _AddEntryWithHandle(_Callable(tag, _GetAllocator(), std::forward<TArgs>(args)...));
+        }
+        return _AddEntryWithHandle(tag, _GetAllocator(), std::forward<TArgs>(args)...);
+    }
+
+    template <typename... TArgs>
+    DelegateHandle _AddEntryWithHandle(TArgs &&...args)
+    {
+        // Everything that may throw is allocated before the list is changed.
+        std::unique_ptr<_SlotMap, _Deleter<_SlotMap>> slotMap(nullptr, _Deleter<_SlotMap>(_GetAllocator()));
+        if (_funcs == nullptr || _funcs->slotMap == nullptr) {
+            slotMap.reset(_New<_SlotMap>(_GetAllocator(), _GetAllocator()));
+            slotMap->itemSlots.reserve(_Count() + 1);
+            slotMap->itemSlots.resize(_Count(), _SlotMap::_NoSlot);
+            slotMap->Reserve();
+        }
+        if (_funcs == nullptr) {
+            _Spill(1);
+        }
+        _FuncList &funcs = _MutableFuncs(1);
+        if (slotMap) {
+            funcs.slotMap = slotMap.release();
+        } else {
+            funcs.slotMap->Reserve();
+        }
+        funcs.EmplaceBack(std::forward<TArgs>(args)...);
+        return funcs.slotMap->Acquire(funcs.count - 1);
+    }
+
+    // Returns the position of the first entry equal to callable in [begin, _Count()), or _Count().
+    // Heap lists compare fingerprints first, so only entries that are likely equal are compared.
+    template <typename T>
+    size_t _Find(const T &callable, uint64_t fingerprint, size_t begin) const
+    {
+        const _Callable *items = _Items();
+        size_t count           = _Count();
+        for (size_t i = begin; i < count; ++i) {
+            if (_funcs) {
+                i = _FindFingerprint(_funcs->Fingerprints(), i, count, fingerprint);
+                if (i == count) {
+                    break;
+                }
+            }
+            if (items[i].Matches(callable)) {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    // Returns the position of the last entry equal to callable, or _Count().
+    template <typename T>
+    size_t _FindLast(const T &callable) const
+    {
+        const _Callable *items = _Items();
+        size_t count           = _Count();
+        if (_funcs == nullptr) {
+            for (size_t i = count; i > 0; --i) {
+                if (items[i - 1].Matches(callable)) {
+                    return i - 1;
+                }
+            }
+            return count;
+        }
+        uint64_t fingerprint = _Fingerprint(callable);
+        for (size_t end = count, i; (i = _FindLastFingerprint(_funcs->Fingerprints(), end, fingerprint)) != end; end = i) {
+            if (items[i].Matches(callable)) {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    template <typename T>
+    bool _Contains(const T &callable) const
+    {
+        return _FindLast(callable) != _Count();
+    }
+
+    template <typename T>
+    size_t _IndexOf(const T &callable) const
+    {
+        size_t index = _Find(callable, _Fingerprint(callable), 0);
+        if (index == _Count()) {
+            return npos;
+        }
+        if (_funcs && _funcs->removedCount != 0) {
+            // Removed entries have fingerprint 0 and do not count.
+            const uint64_t *fingerprints = _funcs->Fingerprints();
+            size_t position              = index;
+            for (size_t i = 0; i < index; ++i) {
+                position -= fingerprints[i] == 0;
+            }
+            return position;
+        }
+        return index;
+    }
+
+    template <typename T>
+    size_t _CountOf(const T &callable) const
+    {
+        uint64_t fingerprint = _Fingerprint(callable);
+        size_t count         = _Count();
+        size_t result        = 0;
+        for (size_t i = _Find(callable, fingerprint, 0); i != count; i = _Find(callable, fingerprint, i + 1)) {
+            ++result;
+        }
+        return result;
+    }
+
+    template <typename T>
+    void _Remove(const T &callable)
+    {
+        size_t index = _FindLast(callable);
+        if (index == _Count()) {
+            return;
+        }
+        if (_funcs == nullptr && !_InlineRaising()) {
+            _EraseItem(_InlineItems(), _inlineCount, _inlineNonTrivial, index);
+            return;
+        }
+        if (_funcs == nullptr) {
+            _Spill(0);
+        }
+        _FuncList &funcs = _MutableFuncs(0);
+        funcs.Kill(index);
+        if (funcs.count == 0) {
+            _ReleaseFuncs();
+        }
+    }
+};
+
+#if _DELEGATE_CPLUSPLUS < 201703L
+template <typename TRet, typename... Args, size_t InlineCount, typename TAllocator>
+constexpr size_t Delegate<TRet(Args...), InlineCount, TAllocator>::npos;
+#endif
+
+namespace std
+{
+template <typename TSignature, size_t InlineCount, typename TAllocator>
+struct hash<Delegate<TSignature, InlineCount, TAllocator>> {
+    size_t operator()(const Delegate<TSignature, InlineCount, TAllocator> &value) const
+    {
+        return value.GetHashCode();
+    }
+};
+} // namespace std
+
+template <typename T, size_t InlineCount = 1>
+using Func = Delegate<T, InlineCount>;
+
+template <typename... Args>
+using Action = Delegate<void(Args...)>;
+
+// A delegate that is the size of a pointer, its invocation list is allocated by the first Add.
+// Use it for events that mostly have no callables.
+template <typename T>
+using CompactDelegate = Delegate<T, 0>;
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+// A delegate that allocates from a memory resource, e.g. a std::pmr::monotonic_buffer_resource per request.
+// The delegates have to be destroyed before the resource is released.
+template <typename T, size_t InlineCount = 1>
+using PmrDelegate = Delegate<T, InlineCount, std::pmr::polymorphic_allocator<char>>;
+#endif
+
+template <typename>
+class ConcurrentDelegate;
+
+// A multicast delegate that can be invoked and modified from multiple threads.
+// Each modification publishes a new immutable snapshot of the invocation list, invocations
+// never take a lock and never wait for writers. Replaced snapshots are reclaimed once no
+// invocation that may still use them is running (epoch-based reclamation).
+template <typename TRet, typename... Args>
+class ConcurrentDelegate<TRet(Args...)> final
+{
+private:
+    using _Snapshot = Delegate<TRet(Args...)>;
+
+    struct _RetiredSnapshot {
+        const _Snapshot *snapshot;
+        size_t epoch;
+    };
+
+    // Aligned to keep the counters on separate cache lines, also apart from _current and _epoch.
+    struct alignas(64) _ReaderCounter {
+        std::atomic<size_t> count;
+    };
+
+    struct _ReaderGuard {
+        std::atomic<size_t> &count;
+        ~_ReaderGuard()
+        {
+            count.fetch_sub(1, std::memory_order_release);
+        }
+    };
+
+private:
+    std::atomic<const _Snapshot *> _current;
+    std::atomic<size_t> _epoch;
+    mutable _ReaderCounter _readers[3];
+    std::mutex _writeMutex;
+    std::vector<_RetiredSnapshot> _retired;
+
+public:
+    ConcurrentDelegate(std::nullptr_t = nullptr)
+        : ConcurrentDelegate(_Snapshot())
+    {
+    }
+
+    ConcurrentDelegate(const _Snapshot &value)
+        : _current(new _Snapshot(value)), _epoch(0)
+    {
+        for (auto &reader : _readers) {
+            reader.count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentDelegate(const ConcurrentDelegate &)            = delete;
+    ConcurrentDelegate &operator=(const ConcurrentDelegate &) = delete;
+
+    ~ConcurrentDelegate()
+    {
+        delete _current.load(std::memory_order_relaxed);
+        for (auto &item : _retired) {
+            delete item.snapshot;
+        }
+    }
+
+    TRet operator()(Args... args) const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return (*_current.load(std::memory_order_seq_cst))(std::forward<Args>(args)...);
+    }
+
+    TRet Invoke(Args... args) const
+    {
+        return (*this)(std::forward<Args>(args)...);
+    }
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    auto TryInvoke(Args... args) const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return _current.load(std::memory_order_seq_cst)->TryInvoke(std::forward<Args>(args)...);
+    }
+#endif
+
+    // Returns a copy of the current invocation list.
+    _Snapshot Snapshot() const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return *_current.load(std::memory_order_seq_cst);
+    }
+
+    bool IsNull() const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return _current.load(std::memory_order_seq_cst)->IsNull();
+    }
+
+    template <typename... TArgs>
+    bool Contains(TArgs &&...args) const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return _current.load(std::memory_order_seq_cst)->Contains(std::forward<TArgs>(args)...);
+    }
+
+    template <typename... TArgs>
+    size_t IndexOf(TArgs &&...args) const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return _current.load(std::memory_order_seq_cst)->IndexOf(std::forward<TArgs>(args)...);
+    }
+
+    template <typename... TArgs>
+    size_t Count(TArgs &&...args) const
+    {
+        _ReaderGuard guard{_EnterRead()};
+        return _current.load(std::memory_order_seq_cst)->Count(std::forward<TArgs>(args)...);
+    }
+
+    ConcurrentDelegate &operator=(const _Snapshot &value)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot = value; });
+        return *this;
+    }
+
+    ConcurrentDelegate &operator=(std::nullptr_t)
+    {
+        Clear();
+        return *this;
+    }
+
+    void Clear()
+    {
+        _Update([](_Snapshot &snapshot) { snapshot.Clear(); });
+    }
+
+    template <typename... TArgs>
+    void Add(TArgs &&...args)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot.Add(std::forward<TArgs>(args)...); });
+    }
+
+    template <typename TIterator>
+    void AddRange(TIterator first, TIterator last)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot.AddRange(first, last); });
+    }
+
+    void Append(const _Snapshot &other)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot.Append(other); });
+    }
+
+    template <typename T, typename... TArgs>
+    void Emplace(TArgs &&...args)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot.template Emplace<T>(std::forward<TArgs>(args)...); });
+    }
+
+    template <typename... TArgs>
+    bool AddUnique(TArgs &&...args)
+    {
+        bool added = false;
+        _Update([&](_Snapshot &snapshot) { added = snapshot.AddUnique(std::forward<TArgs>(args)...); });
+        return added;
+    }
+
+    template <typename... TArgs>
+    DelegateHandle AddWithHandle(TArgs &&...args)
+    {
+        DelegateHandle handle;
+        _Update([&](_Snapshot &snapshot) { handle = snapshot.AddWithHandle(std::forward<TArgs>(args)...); });
+        return handle;
+    }
+
+    template <typename... TArgs>
+    void Remove(TArgs &&...args)
+    {
+        _Update([&](_Snapshot &snapshot) { snapshot.Remove(std::forward<TArgs>(args)...); });
+    }
+
+    template <typename T>
+    ConcurrentDelegate &operator+=(T &&callable)
+    {
+        Add(std::forward<T>(callable));
+        return *this;
+    }
+
+    template <typename T>
+    ConcurrentDelegate &operator-=(T &&callable)
+    {
+        Remove(std::forward<T>(callable));
+        return *this;
+    }
+
+private:
+    std::atomic<size_t> &_EnterRead() const
+    {
+        for (;;) {
+            size_t epoch  = _epoch.load(std::memory_order_seq_cst);
+            auto &counter = _readers[epoch % 3].count;
+            counter.fetch_add(1, std::memory_order_seq_cst);
+            // The epoch may have advanced before the counter was incremented,
+            // in that case the counter does not protect anything and we have to retry.
+            if (_epoch.load(std::memory_order_seq_cst) == epoch) {
+                return counter;
+            }
+            counter.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    template <typename TFunc>
+    void _Update(TFunc &&func)
+    {
+        std::lock_guard<std::mutex> lock(_writeMutex);
+        std::unique_ptr<_Snapshot> next(new _Snapshot(*_current.load(std::memory_order_relaxed)));
+        func(*next);
+        const _Snapshot *prev = _current.exchange(next.release(), std::memory_order_seq_cst);
+        _retired.push_back({prev, _epoch.load(std::memory_order_relaxed)});
+        _Reclaim();
+    }
+
+    // A snapshot retired in epoch e can only be referenced by readers that entered in epoch e or earlier,
+    // so it can be deleted once the epoch reaches e + 2. The epoch only advances when no reader is left
+    // in the epoch before the current one, writers never wait for readers.
+    void _Reclaim()
+    {
+        for (int i = 0; i < 2; ++i) {
+            size_t epoch = _epoch.load(std::memory_order_relaxed);
+            if (_readers[(epoch + 2) % 3].count.load(std::memory_order_seq_cst) != 0) {
+                break;
+            }
+            _epoch.store(epoch + 1, std::memory_order_seq_cst);
+        }
+        size_t epoch = _epoch.load(std::memory_order_relaxed);
+        size_t kept  = 0;
+        for (auto &item : _retired) {
+            if (item.epoch + 2 <= epoch) {
+                delete item.snapshot;
+            } else {
+                _retired[kept++] = item;
+            }
+        }
+        _retired.resize(kept);
+    }
+};
+
+// Operations on a callable stored in the buffer of a TStorage, shared by StaticDelegate and InplaceDelegate.
+// copy, move and destroy are null for trivially copyable callables, which are copied with memcpy.
+template <typename TStorage>
+struct _DelegateBufferManager {
+    void (*copy)(TStorage &dst, const TStorage &src);
+    void (*move)(TStorage &dst, TStorage &src); // src is destroyed
+    void (*destroy)(TStorage &storage);
+    bool (*equals)(const TStorage &a, const TStorage &b);
+    size_t size; // bytes of the storage that hold the callable, 0 for empty types
+};
+
+template <typename TSignature, typename TStorage, typename T>
+struct _DelegateBufferOps {
+    static T &Get(TStorage &storage)
+    {
+        return *reinterpret_cast<T *>(storage.buf);
+    }
+    static const T &Get(const TStorage &storage)
+    {
+        return *reinterpret_cast<const T *>(storage.buf);
+    }
+    static void Copy(TStorage &dst, const TStorage &src)
+    {
+        new (dst.buf) T(Get(src));
+    }
+    static void Move(TStorage &dst, TStorage &src)
+    {
+        new (dst.buf) T(std::move(Get(src)));
+        Destroy(src);
+    }
+    static void Destroy(TStorage &storage)
+    {
+        Get(storage).~T();
+    }
+    static bool Equals(const TStorage &a, const TStorage &b)
+    {
+        return TSignature::_CallableEquals(Get(a), Get(b));
+    }
+    static const _DelegateBufferManager<TStorage> *GetManager()
+    {
+        static const _DelegateBufferManager<TStorage> manager = {
+            std::is_trivially_copyable<T>::value ? nullptr : &Copy,
+            std::is_trivially_copyable<T>::value ? nullptr : &Move,
+            std::is_trivially_copyable<T>::value ? nullptr : &Destroy,
+            &Equals,
+            std::is_empty<T>::value ? 0 : sizeof(T),
+        };
+        return &manager;
+    }
+};
+
+template <typename, size_t MaxHandlers, size_t BytesPerHandler = 4 * sizeof(void *)>
+class StaticDelegate;
+
+// A multicast delegate with a fixed capacity that never allocates, e.g. for real-time threads.
+// Up to MaxHandlers callables are stored in the delegate object itself, BytesPerHandler bytes each,
+// callables that do not fit are rejected at compile time. Adding a callable to a full delegate throws
+// std::length_error, or aborts if exceptions are disabled, TryAdd returns false instead.
+// The default constructor is constexpr, so static delegates are initialized at compile time.
+#if _DELEGATE_CPLUSPLUS >= 201703L
+template <typename TRet, typename... Args, size_t MaxHandlers, size_t BytesPerHandler, bool NoExcept>
+class StaticDelegate<TRet(Args...) noexcept(NoExcept), MaxHandlers, BytesPerHandler> final
+#else
+template <typename TRet, typename... Args, size_t MaxHandlers, size_t BytesPerHandler>
+class StaticDelegate<TRet(Args...), MaxHandlers, BytesPerHandler> final
+#endif
+{
+    static_assert(MaxHandlers > 0, "MaxHandlers must be greater than zero");
+    static_assert(BytesPerHandler >= sizeof(void *), "BytesPerHandler must hold at least a pointer");
+
+private:
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _Signature = _DelegateSignature<TRet(Args...) noexcept(NoExcept)>;
+#else
+    using _Signature = _DelegateSignature<TRet(Args...)>;
+#endif
+
+    static constexpr bool _NoExcept = _Signature::_NoExcept;
+
+    using _FunctionPointer = typename _Signature::_FunctionPointer;
+
+    template <typename TObject>
+    using _MethodPointer = typename _Signature::template _MethodPointer<TObject>;
+
+    template <typename TObject>
+    using _ConstMethodPointer = typename _Signature::template _ConstMethodPointer<TObject>;
+
+    struct _Storage {
+        alignas(std::max_align_t) char buf[BytesPerHandler];
+    };
+
+    // Arguments are passed on as in Delegate, all callables but the last share them.
+    template <typename A>
+    using _ArgRef = typename _Signature::template _ArgRef<A>;
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _InvokeFunc = TRet (*)(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args) noexcept(NoExcept);
+#else
+    using _InvokeFunc = TRet (*)(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args);
+#endif
+
+    using _Manager = _DelegateBufferManager<_Storage>;
+
+    template <typename TObject>
+    using _MemberFunctionWrapper = typename _Signature::template _MemberFunctionWrapper<TObject>;
+
+    template <typename TObject>
+    using _ConstMemberFunctionWrapper = typename _Signature::template _ConstMemberFunctionWrapper<TObject>;
+
+    template <typename T>
+    struct _CallableOps : _DelegateBufferOps<_Signature, _Storage, T> {
+        static_assert(sizeof(T) <= BytesPerHandler && alignof(T) <= alignof(std::max_align_t),
+                      "the callable does not fit in BytesPerHandler bytes");
+        static_assert(std::is_copy_constructible<T>::value && std::is_nothrow_move_constructible<T>::value,
+                      "StaticDelegate requires callables that are copyable and nothrow movable");
+
+        static TRet Invoke(const _Storage &storage, bool forwardArgs, _ArgRef<Args>... args) noexcept(_NoExcept)
+        {
+            return _Signature::_Invoke(_CallableOps::Get(storage), forwardArgs, args...);
+        }
+    };
+
+    template <typename T>
+    using _StoredType = typename _Signature::template _StoredType<T>;
+
+    struct _Entry {
+        _InvokeFunc invoke;
+        const _Manager *manager;
+        _Storage storage;
+    };
+
+    // The first _count entries are the invocation list. _items is left uninitialized by the
+    // constexpr constructor, _noItems is the active member of the union until a callable is added.
+    union {
+        char _noItems;
+        _Entry _items[MaxHandlers];
+    };
+    size_t _count;
+
+public:
+    static constexpr size_t Capacity = MaxHandlers;
+
+    constexpr StaticDelegate(std::nullptr_t = nullptr) noexcept
+        : _noItems(), _count(0)
+    {
+    }
+
+    // The delegating constructor makes sure the copied callables are destroyed if a copy throws.
+    StaticDelegate(const StaticDelegate &other)
+        : StaticDelegate()
+    {
+        _CopyFrom(other);
+    }
+
+    StaticDelegate(StaticDelegate &&other) noexcept
+        : StaticDelegate()
+    {
+        _MoveFrom(other);
+    }
+
+    ~StaticDelegate()
+    {
+        Clear();
+    }
+
+    template <typename TCallableObject, typename = typename std::enable_if<!std::is_same<typename std::decay<TCallableObject>::type, StaticDelegate>::value>::type>
+    StaticDelegate(TCallableObject &&callable)
+        : StaticDelegate()
+    {
+        Add(std::forward<TCallableObject>(callable));
+    }
+
+    template <typename TObject>
+    StaticDelegate(TObject &obj, _MethodPointer<TObject> func)
+        : StaticDelegate()
+    {
+        Add(obj, func);
+    }
+
+    template <typename TObject>
+    StaticDelegate(const TObject &obj, _ConstMethodPointer<TObject> func)
+        : StaticDelegate()
+    {
+        Add(obj, func);
+    }
+
+    StaticDelegate &operator=(const StaticDelegate &other)
+    {
+        if (this != &other) {
+            Clear();
+            _CopyFrom(other);
+        }
+        return *this;
+    }
+
+    StaticDelegate &operator=(StaticDelegate &&other) noexcept
+    {
+        if (this != &other) {
+            Clear();
+            _MoveFrom(other);
+        }
+        return *this;
+    }
+
+    StaticDelegate &operator=(std::nullptr_t)
+    {
+        Clear();
+        return *this;
+    }
+
+    void Clear()
+    {
+        for (size_t i = 0; i < _count; ++i) {
+            if (_items[i].manager->destroy) {
+                _items[i].manager->destroy(_items[i].storage);
+            }
+        }
+        _count = 0;
+    }
+
+    bool IsNull() const
+    {
+        return _count == 0;
+    }
+
+    bool IsFull() const
+    {
+        return _count == MaxHandlers;
+    }
+
+    // Invokes the callables in order and returns the result of the last one, see Delegate::operator().
+    TRet operator()(Args... args) const noexcept(_NoExcept)
+    {
+        if (_count == 0) {
+            return _Signature::_InvokeEmpty(std::integral_constant<bool, _NoExcept>());
+        }
+        for (size_t i = 0; i < _count - 1; ++i) {
+            _items[i].invoke(_items[i].storage, false, args...);
+        }
+        return _items[_count - 1].invoke(_items[_count - 1].storage, true, args...);
+    }
+
+    TRet Invoke(Args... args) const noexcept(_NoExcept)
+    {
+        return (*this)(std::forward<Args>(args)...);
+    }
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    // Invokes the callables unless the delegate is empty, see Delegate::TryInvoke.
+    typename std::conditional<std::is_void<TRet>::value, bool, std::optional<TRet>>::type TryInvoke(Args... args) const noexcept(_NoExcept)
+    {
+        if (IsNull()) {
+            return {};
+        }
+        if constexpr (std::is_void<TRet>::value) {
+            (*this)(std::forward<Args>(args)...);
+            return true;
+        } else {
+            return (*this)(std::forward<Args>(args)...);
+        }
+    }
+#endif
+
+    // Adds the callable unless the delegate is full, returns whether it was added.
+    template <typename TCallableObject>
+    bool TryAdd(TCallableObject &&callable)
+    {
+        return _TryAdd(_TypeTag<_StoredType<typename std::decay<TCallableObject>::type>>(), std::forward<TCallableObject>(callable));
+    }
+
+    bool TryAdd(_FunctionPointer ptr)
+    {
+        return ptr == nullptr || _TryAdd(_TypeTag<_FunctionPointer>(), ptr);
+    }
+
+    bool TryAdd(std::nullptr_t)
+    {
+        return true;
+    }
+
+    template <typename TObject>
+    bool TryAdd(TObject &obj, _MethodPointer<TObject> func)
+    {
+        return func == nullptr || _TryAdd(_TypeTag<_MemberFunctionWrapper<TObject>>(), obj, func);
+    }
+
+    template <typename TObject>
+    bool TryAdd(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        return func == nullptr || _TryAdd(_TypeTag<_ConstMemberFunctionWrapper<TObject>>(), obj, func);
+    }
+
+    // Adds a callable, see TryAdd. Adding to a full delegate throws std::length_error or aborts.
+    template <typename... TArgs>
+    void Add(TArgs &&...args)
+    {
+        if (!TryAdd(std::forward<TArgs>(args)...)) {
+            _Overflow();
+        }
+    }
+
+    template <typename T>
+    StaticDelegate &operator+=(T &&callable)
+    {
+        Add(std::forward<T>(callable));
+        return *this;
+    }
+
+    // Removes the last callable equal to callable, see DelegateCallableTraits.
+    template <typename TCallableObject>
+    void Remove(const TCallableObject &callable)
+    {
+        _Remove(static_cast<const _StoredType<TCallableObject> &>(callable));
+    }
+
+    void Remove(_FunctionPointer ptr)
+    {
+        if (ptr) {
+            _Remove(ptr);
+        }
+    }
+
+    void Remove(std::nullptr_t)
+    {
+    }
+
+    template <typename TObject>
+    void Remove(TObject &obj, _MethodPointer<TObject> func)
+    {
+        if (func) {
+            _Remove(_MemberFunctionWrapper<TObject>(obj, func));
+        }
+    }
+
+    template <typename TObject>
+    void Remove(const TObject &obj, _ConstMethodPointer<TObject> func)
+    {
+        if (func) {
+            _Remove(_ConstMemberFunctionWrapper<TObject>(obj, func));
+        }
+    }
+
+    template <typename T>
+    StaticDelegate &operator-=(const T &callable)
+    {
+        Remove(callable);
+        return *this;
+    }
+
+    template <typename TCallableObject>
+    bool Contains(const TCallableObject &callable) const
+    {
+        return _FindLast(static_cast<const _StoredType<TCallableObject> &>(callable)) != _count;
+    }
+
+    bool Contains(_FunctionPointer ptr) const
+    {
+        return ptr != nullptr && _FindLast(ptr) != _count;
+    }
+
+    template <typename TObject>
+    bool Contains(TObject &obj, _MethodPointer<TObject> func) const
+    {
+        return func != nullptr && _FindLast(_MemberFunctionWrapper<TObject>(obj, func)) != _count;
+    }
+
+    template <typename TObject>
+    bool Contains(const TObject &obj, _ConstMethodPointer<TObject> func) const
+    {
+        return func != nullptr && _FindLast(_ConstMemberFunctionWrapper<TObject>(obj, func)) != _count;
+    }
+
+    bool operator==(const StaticDelegate &other) const
+    {
+        if (_count != other._count) {
+            return false;
+        }
+        for (size_t i = 0; i < _count; ++i) {
+            if (_items[i].manager != other._items[i].manager ||
+                !_items[i].manager->equals(_items[i].storage, other._items[i].storage)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const StaticDelegate &other) const
+    {
+        return !(*this == other);
+    }
+
+    bool operator==(std::nullptr_t) const
+    {
+        return IsNull();
+    }
+
+    bool operator!=(std::nullptr_t) const
+    {
+        return !IsNull();
+    }
+
 private:
-    struct _ICallable {
-        virtual ~_ICallable()                              = default;
-        virtual TRet Invoke(Args... args) const            = 0;
-        virtual _ICallable *Clone() const                  = 0;
-        virtual const std::type_info *GetTypeInfo() const  = 0;
-        virtual bool Equals(const _ICallable &other) const = 0;
+    template <typename T>
+    struct _TypeTag {
     };
 
-    template <typename TCallableObject>
-    struct _CallableObjectWrapper : _ICallable {
-        alignas(TCallableObject) char _buf[sizeof(TCallableObject)];
-        _CallableObjectWrapper(const TCallableObject &obj)
-        {
-            memset(_buf, 0, sizeof(_buf));
-            new (_buf) TCallableObject(obj);
-        }
-        _CallableObjectWrapper(const _CallableObjectWrapper &other)
-        {
-            memset(_buf, 0, sizeof(_buf));
-            new (_buf) TCallableObject(other.GetObject());
-        }
-        virtual ~_CallableObjectWrapper()
-        {
-            GetObject().~TCallableObject();
-        }
-        TCallableObject &GetObject()
-        {
-            return *reinterpret_cast<TCallableObject *>(_buf);
-        }
-        const TCallableObject &GetObject() const
-        {
-            return *reinterpret_cast<const TCallableObject *>(_buf);
-        }
-        virtual TRet Invoke(Args... args) const override
-        {
-            return GetObject()(std::forward<Args>(args)...);
-        }
-        virtual _ICallable *Clone() const override
-        {
-            return new _CallableObjectWrapper(*this);
+    _DELEGATE_COLD static void _Overflow()
+    {
+#if defined(DELEGATE_NO_EXCEPTIONS)
+        std::abort();
+#else
+        throw std::length_error("static delegate is full");
+#endif
+    }
+
+    template <typename T, typename... TArgs>
+    bool _TryAdd(_TypeTag<T>, TArgs &&...args)
+    {
+        if (_count == MaxHandlers) {
+            return false;
         }
-        virtual const std::type_info *GetTypeInfo() const override
-        {
-            return &typeid(TCallableObject);
+        _Entry &entry = _items[_count];
+        new (entry.storage.buf) T(std::forward<TArgs>(args)...);
+        entry.invoke  = &_CallableOps<T>::Invoke;
+        entry.manager = _CallableOps<T>::GetManager();
+        ++_count;
+        return true;
+    }
+
+    // Moves the entry src to uninitialized dst.
+    static void _Relocate(_Entry &dst, _Entry &src) noexcept
+    {
+        dst.invoke  = src.invoke;
+        dst.manager = src.manager;
+        if (src.manager->move) {
+            src.manager->move(dst.storage, src.storage);
+        } else {
+            memcpy(dst.storage.buf, src.storage.buf, src.manager->size);
         }
-        virtual bool Equals(const _ICallable &other) const override
-        {
-            auto typeinfo = GetTypeInfo();
-            if (typeinfo != other.GetTypeInfo()) {
-                return false;
-            }
-            if (typeinfo == &typeid(Delegate<TRet(Args...)>)) {
-                return *reinterpret_cast<const Delegate<TRet(Args...)> *>(_buf) ==
-                       *reinterpret_cast<const Delegate<TRet(Args...)> *>(static_cast<const _CallableObjectWrapper &>(other)._buf);
+    }
+
+    void _CopyFrom(const StaticDelegate &other)
+    {
+        for (; _count < other._count; ++_count) {
+            const _Entry &src = other._items[_count];
+            _Entry &dst       = _items[_count];
+            if (src.manager->copy) {
+                src.manager->copy(dst.storage, src.storage);
             } else {
-                // Unknown type, could be a function pointer, lambda, or other type.
-                // Comparing function pointers and lambdas without captured variables is generally safe,
-                // since they can be converted to function pointers and have well-defined layouts.
-                // However, using memcpy to compare lambdas with captured variables or custom types
-                // is undefined behavior, as their memory layouts are not standardized in the C++ specification.
-                return memcmp(_buf, static_cast<const _CallableObjectWrapper &>(other)._buf, sizeof(_buf)) == 0;
+                memcpy(dst.storage.buf, src.storage.buf, src.manager->size);
             }
+            dst.invoke  = src.invoke;
+            dst.manager = src.manager;
         }
-    };
+    }
 
-    template <typename TObject>
-    struct _MemberFunctionWrapper : _ICallable {
-        TObject *_pObj;
-        TRet (TObject::*_func)(Args...);
-        _MemberFunctionWrapper(TObject &obj, TRet (TObject::*func)(Args...))
-            : _pObj(&obj), _func(func)
-        {
-        }
-        virtual TRet Invoke(Args... args) const override
-        {
-            return (_pObj->*_func)(std::forward<Args>(args)...);
-        }
-        virtual _ICallable *Clone() const override
-        {
-            return new _MemberFunctionWrapper(*_pObj, _func);
-        }
-        virtual const std::type_info *GetTypeInfo() const override
-        {
-            return &typeid(_func);
+    void _MoveFrom(StaticDelegate &other) noexcept
+    {
+        for (size_t i = 0; i < other._count; ++i) {
+            _Relocate(_items[i], other._items[i]);
         }
-        virtual bool Equals(const _ICallable &other) const override
-        {
-            if (GetTypeInfo() != other.GetTypeInfo()) {
-                return false;
+        _count       = other._count;
+        other._count = 0;
+    }
+
+    template <typename T>
+    size_t _FindLast(const T &callable) const
+    {
+        const _Manager *manager = _CallableOps<T>::GetManager();
+        for (size_t i = _count; i > 0; --i) {
+            if (_items[i - 1].manager == manager && _Signature::_CallableEquals(_CallableOps<T>::Get(_items[i - 1].storage), callable)) {
+                return i - 1;
             }
-            auto &mfw = static_cast<const _MemberFunctionWrapper &>(other);
-            return _pObj == mfw._pObj && _func == mfw._func;
         }
-    };
+        return _count;
+    }
 
-    template <typename TObject>
-    struct _ConstMemberFunctionWrapper : _ICallable {
-        const TObject *_pObj;
-        TRet (TObject::*_func)(Args...) const;
-        _ConstMemberFunctionWrapper(const TObject &obj, TRet (TObject::*func)(Args...) const)
-            : _pObj(&obj), _func(func)
-        {
-        }
-        virtual TRet Invoke(Args... args) const override
-        {
-            return (_pObj->*_func)(std::forward<Args>(args)...);
-        }
-        virtual _ICallable *Clone() const override
-        {
-            return new _ConstMemberFunctionWrapper(*_pObj, _func);
+    template <typename T>
+    void _Remove(const T &callable)
+    {
+        size_t index = _FindLast(callable);
+        if (index == _count) {
+            return;
         }
-        virtual const std::type_info *GetTypeInfo() const override
-        {
-            return &typeid(_func);
+        if (_items[index].manager->destroy) {
+            _items[index].manager->destroy(_items[index].storage);
         }
-        virtual bool Equals(const _ICallable &other) const override
-        {
-            if (GetTypeInfo() != other.GetTypeInfo()) {
-                return false;
-            }
-            auto &cmfw = static_cast<const _ConstMemberFunctionWrapper &>(other);
-            return _pObj == cmfw._pObj && _func == cmfw._func;
+        for (size_t i = index + 1; i < _count; ++i) {
+            _Relocate(_items[i - 1], _items[i]);
         }
-    };
+        --_count;
+    }
+};
+
+#if _DELEGATE_CPLUSPLUS < 201703L
+template <typename TRet, typename... Args, size_t MaxHandlers, size_t BytesPerHandler>
+constexpr size_t StaticDelegate<TRet(Args...), MaxHandlers, BytesPerHandler>::Capacity;
+#endif
+
+template <typename>
+class FunctionRef;
 
+// A non-owning reference to a callable, e.g. for callback parameters that are only invoked during the call.
+// It is two pointers, trivially copyable and never allocates. The referenced callable, e.g. a lambda or a
+// Delegate, must outlive the FunctionRef, a Delegate is invoked through its own invocation list without
+// copying it. Function pointers are stored by value, member functions are bound with Bind.
+#if _DELEGATE_CPLUSPLUS >= 201703L
+template <typename TRet, typename... Args, bool NoExcept>
+class FunctionRef<TRet(Args...) noexcept(NoExcept)> final
+#else
+template <typename TRet, typename... Args>
+class FunctionRef<TRet(Args...)> final
+#endif
+{
 private:
-    std::vector<std::unique_ptr<_ICallable>> _funcs;
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _Signature = _DelegateSignature<TRet(Args...) noexcept(NoExcept)>;
+#else
+    using _Signature = _DelegateSignature<TRet(Args...)>;
+#endif
+
+    static constexpr bool _NoExcept = _Signature::_NoExcept;
+
+    using _FunctionPointer = typename _Signature::_FunctionPointer;
+
+    template <typename TObject>
+    using _MethodPointer = typename _Signature::template _MethodPointer<TObject>;
+
+    template <typename TObject>
+    using _ConstMethodPointer = typename _Signature::template _ConstMethodPointer<TObject>;
+
+    union _Target {
+        void *obj;
+        _FunctionPointer func;
+    };
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _InvokeFunc = TRet (*)(_Target target, Args &&...args) noexcept(NoExcept);
+#else
+    using _InvokeFunc = TRet (*)(_Target target, Args &&...args);
+#endif
+
+    // Functions and function pointers are converted to _FunctionPointer instead of being referenced.
+    template <typename T>
+    using _EnableIfCallable = typename std::enable_if<
+        !std::is_same<typename std::decay<T>::type, FunctionRef>::value &&
+        !std::is_function<typename std::remove_reference<T>::type>::value &&
+        !std::is_pointer<typename std::decay<T>::type>::value &&
+        (std::is_void<TRet>::value || std::is_convertible<decltype(std::declval<T &>()(std::declval<Args>()...)), TRet>::value)>::type;
+
+    template <typename T>
+    static TRet _InvokeObject(_Target target, Args &&...args) noexcept(_NoExcept)
+    {
+        static_assert(!_NoExcept || noexcept(std::declval<T &>()(std::declval<Args>()...)),
+                      "a noexcept FunctionRef only accepts noexcept callables");
+        return (*static_cast<T *>(target.obj))(std::forward<Args>(args)...);
+    }
+
+    static TRet _InvokeFunction(_Target target, Args &&...args) noexcept(_NoExcept)
+    {
+        return target.func(std::forward<Args>(args)...);
+    }
+
+    template <typename TObject, typename TMethod, TMethod Method>
+    static TRet _InvokeMethod(_Target target, Args &&...args) noexcept(_NoExcept)
+    {
+        static_assert(!_NoExcept || noexcept((std::declval<TObject *>()->*Method)(std::declval<Args>()...)),
+                      "a noexcept FunctionRef only accepts noexcept callables");
+        return (static_cast<TObject *>(target.obj)->*Method)(std::forward<Args>(args)...);
+    }
+
+    _Target _target;
+    _InvokeFunc _invoke;
+
+    FunctionRef(void *obj, _InvokeFunc invoke) noexcept
+        : _invoke(invoke)
+    {
+        _target.obj = obj;
+    }
 
 public:
-    Delegate(std::nullptr_t = nullptr)
+    FunctionRef(_FunctionPointer func) noexcept
+        : _invoke(&_InvokeFunction)
     {
+        _target.func = func;
     }
 
-    Delegate(const Delegate &other)
+    template <typename T, typename = _EnableIfCallable<T>>
+    FunctionRef(T &&callable) noexcept
+        : _invoke(&_InvokeObject<typename std::remove_reference<T>::type>)
     {
-        _funcs.reserve(other._funcs.size());
-        for (auto &item : other._funcs) {
-            _funcs.emplace_back(item->Clone());
-        }
+        _target.obj = const_cast<void *>(static_cast<const void *>(std::addressof(callable)));
     }
 
-    Delegate(Delegate &&other)
+    // Binds a member function known at compile time, e.g. Bind<Foo, &Foo::Method>(foo).
+    template <typename TObject, _MethodPointer<TObject> Method>
+    static FunctionRef Bind(TObject &obj) noexcept
     {
-        _funcs = std::move(other._funcs);
+        return FunctionRef(std::addressof(obj), &_InvokeMethod<TObject, _MethodPointer<TObject>, Method>);
     }
 
-    template <typename TCallableObject>
-    Delegate(const TCallableObject &callable)
+    template <typename TObject, _ConstMethodPointer<TObject> Method>
+    static FunctionRef Bind(const TObject &obj) noexcept
     {
-        Add(callable);
+        return FunctionRef(const_cast<TObject *>(std::addressof(obj)), &_InvokeMethod<const TObject, _ConstMethodPointer<TObject>, Method>);
     }
 
-    template <typename TObject>
-    Delegate(TObject &obj, TRet (TObject::*func)(Args...))
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    // Binds a member function known at compile time, e.g. Bind<&Foo::Method>(foo).
+    template <auto Method, typename TObject>
+    static FunctionRef Bind(TObject &obj) noexcept
     {
-        Add(obj, func);
+        static_assert(std::is_member_function_pointer<decltype(Method)>::value, "Method must be a member function pointer");
+        return FunctionRef(const_cast<void *>(static_cast<const void *>(std::addressof(obj))), &_InvokeMethod<TObject, decltype(Method), Method>);
+    }
+#endif
+
+    TRet operator()(Args... args) const noexcept(_NoExcept)
+    {
+        return _invoke(_target, std::forward<Args>(args)...);
     }
+};
+
+template <typename, size_t Bytes = 4 * sizeof(void *), size_t Align = alignof(std::max_align_t)>
+class InplaceDelegate;
+
+// A single-cast delegate that stores its callable in place, in a buffer of Bytes bytes aligned to Align.
+// Callables that do not fit are rejected at compile time, there is no heap fallback. The invocation thunk
+// is called directly, copy, move and destroy go through a manager that is only used by non-trivial callables.
+// An InplaceDelegate can be added to a Delegate, and a Delegate that fits, e.g. a CompactDelegate, can be
+// stored in an InplaceDelegate.
+#if _DELEGATE_CPLUSPLUS >= 201703L
+template <typename TRet, typename... Args, size_t Bytes, size_t Align, bool NoExcept>
+class InplaceDelegate<TRet(Args...) noexcept(NoExcept), Bytes, Align> final
+#else
+template <typename TRet, typename... Args, size_t Bytes, size_t Align>
+class InplaceDelegate<TRet(Args...), Bytes, Align> final
+#endif
+{
+    static_assert(Bytes >= sizeof(void *), "Bytes must hold at least a pointer");
+
+private:
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _Signature = _DelegateSignature<TRet(Args...) noexcept(NoExcept)>;
+#else
+    using _Signature = _DelegateSignature<TRet(Args...)>;
+#endif
+
+    static constexpr bool _NoExcept = _Signature::_NoExcept;
+
+    using _FunctionPointer = typename _Signature::_FunctionPointer;
+
+    template <typename TObject>
+    using _MethodPointer = typename _Signature::template _MethodPointer<TObject>;
 
     template <typename TObject>
-    Delegate(const TObject &obj, TRet (TObject::*func)(Args...) const)
+    using _ConstMethodPointer = typename _Signature::template _ConstMethodPointer<TObject>;
+
+    struct _Storage {
+        alignas(Align) char buf[Bytes];
+    };
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    using _InvokeFunc = TRet (*)(const _Storage &storage, Args &&...args) noexcept(NoExcept);
+#else
+    using _InvokeFunc = TRet (*)(const _Storage &storage, Args &&...args);
+#endif
+
+    using _Manager = _DelegateBufferManager<_Storage>;
+
+    template <typename TObject>
+    using _MemberFunctionWrapper = typename _Signature::template _MemberFunctionWrapper<TObject>;
+
+    template <typename TObject>
+    using _ConstMemberFunctionWrapper = typename _Signature::template _ConstMemberFunctionWrapper<TObject>;
+
+    template <typename T>
+    struct _CallableOps : _DelegateBufferOps<_Signature, _Storage, T> {
+        static_assert(sizeof(T) <= Bytes && alignof(T) <= Align, "the callable does not fit in the InplaceDelegate buffer");
+        static_assert(std::is_copy_constructible<T>::value && std::is_nothrow_move_constructible<T>::value,
+                      "InplaceDelegate requires callables that are copyable and nothrow movable");
+
+        static TRet Invoke(const _Storage &storage, Args &&...args) noexcept(_NoExcept)
+        {
+            static_assert(!_NoExcept || noexcept(std::declval<const T &>()(std::declval<Args>()...)),
+                          "a noexcept delegate only accepts noexcept callables");
+            return _CallableOps::Get(storage)(std::forward<Args>(args)...);
+        }
+    };
+
+    template <typename T>
+    using _StoredType = typename _Signature::template _StoredType<T>;
+
+    // An empty delegate has no manager, its thunk applies the empty delegate policy. The buffer is
+    // value-initialized, so the bytes copied from it are never indeterminate, e.g. for empty callables.
+    _InvokeFunc _invoke      = &_InvokeEmpty;
+    const _Manager *_manager = nullptr;
+    _Storage _storage        = {};
+
+public:
+    InplaceDelegate(std::nullptr_t = nullptr) noexcept
     {
-        Add(obj, func);
     }
 
-    TRet operator()(Args... args) const
+    template <typename TCallableObject, typename = typename std::enable_if<!std::is_same<typename std::decay<TCallableObject>::type, InplaceDelegate>::value>::type>
+    InplaceDelegate(TCallableObject &&callable)
+    {
+        _Create<_StoredType<typename std::decay<TCallableObject>::type>>(std::forward<TCallableObject>(callable));
+    }
+
+    InplaceDelegate(_FunctionPointer ptr) noexcept
     {
-        if (_funcs.empty()) {
-            throw std::runtime_error("empty delegate");
+        if (ptr) {
+            _Create<_FunctionPointer>(ptr);
         }
-        for (size_t i = 0; i < _funcs.size() - 1; ++i) {
-            _funcs[i]->Invoke(std::forward<Args>(args)...);
+    }
+
+    template <typename TObject>
+    InplaceDelegate(TObject &obj, _MethodPointer<TObject> func)
+    {
+        if (func) {
+            _Create<_MemberFunctionWrapper<TObject>>(obj, func);
         }
-        return _funcs.back()->Invoke(std::forward<Args>(args)...);
     }
 
-    TRet Invoke(Args... args) const
+    template <typename TObject>
+    InplaceDelegate(const TObject &obj, _ConstMethodPointer<TObject> func)
     {
-        return (*this)(std::forward<Args>(args)...);
+        if (func) {
+            _Create<_ConstMemberFunctionWrapper<TObject>>(obj, func);
+        }
     }
 
-    Delegate &operator=(const Delegate &other)
+    InplaceDelegate(const InplaceDelegate &other)
+        : _invoke(other._invoke), _manager(other._manager)
     {
-        if (this == &other) {
-            return *this;
+        if (_manager && _manager->copy) {
+            _manager->copy(_storage, other._storage);
+        } else if (_manager) {
+            memcpy(_storage.buf, other._storage.buf, _manager->size);
         }
-        _funcs.clear();
-        _funcs.reserve(other._funcs.size());
-        for (auto &item : other._funcs) {
-            _funcs.emplace_back(item->Clone());
+    }
+
+    InplaceDelegate(InplaceDelegate &&other) noexcept
+        : _invoke(other._invoke), _manager(other._manager)
+    {
+        if (_manager && _manager->move) {
+            _manager->move(_storage, other._storage);
+        } else if (_manager) {
+            memcpy(_storage.buf, other._storage.buf, _manager->size);
         }
-        return *this;
+        other._invoke  = &_InvokeEmpty;
+        other._manager = nullptr;
     }
 
-    Delegate &operator=(Delegate &&other)
+    ~InplaceDelegate()
+    {
+        Clear();
+    }
+
+    InplaceDelegate &operator=(const InplaceDelegate &other)
     {
         if (this != &other) {
-            _funcs = std::move(other._funcs);
+            *this = InplaceDelegate(other);
         }
         return *this;
     }
 
-    void Clear()
+    InplaceDelegate &operator=(InplaceDelegate &&other) noexcept
     {
-        _funcs.clear();
+        if (this != &other) {
+            Clear();
+            new (this) InplaceDelegate(std::move(other));
+        }
+        return *this;
     }
 
-    Delegate &operator=(std::nullptr_t)
+    InplaceDelegate &operator=(std::nullptr_t)
     {
-        _funcs.clear();
+        Clear();
         return *this;
     }
 
-    bool IsNull() const
+    void Clear()
     {
-        return _funcs.empty();
+        if (_manager && _manager->destroy) {
+            _manager->destroy(_storage);
+        }
+        _invoke  = &_InvokeEmpty;
+        _manager = nullptr;
     }
 
-    bool operator==(std::nullptr_t) const
+    bool IsNull() const
     {
-        return _funcs.empty();
+        return _manager == nullptr;
     }
 
-    bool operator!=(std::nullptr_t) const
+    TRet operator()(Args... args) const noexcept(_NoExcept)
     {
-        return !_funcs.empty();
+        return _invoke(_storage, std::forward<Args>(args)...);
     }
 
-    template <typename TCallableObject>
-    void Add(const TCallableObject &callable)
+    TRet Invoke(Args... args) const noexcept(_NoExcept)
     {
-        _funcs.emplace_back(new _CallableObjectWrapper<TCallableObject>(callable));
+        return _invoke(_storage, std::forward<Args>(args)...);
     }
 
-    void Add(TRet (*ptr)(Args...))
+    // Delegates are equal if they are empty or their callables are equal, see DelegateCallableTraits.
+    bool operator==(const InplaceDelegate &other) const
     {
-        if (ptr) {
-            _funcs.emplace_back(new _CallableObjectWrapper<decltype(ptr)>(ptr));
-        }
+        return _manager == other._manager && (_manager == nullptr || _manager->equals(_storage, other._storage));
     }
 
-    void Add(std::nullptr_t)
+    bool operator!=(const InplaceDelegate &other) const
     {
+        return !(*this == other);
     }
 
-    template <typename TObject>
-    void Add(TObject &obj, TRet (TObject::*func)(Args...))
+    bool operator==(std::nullptr_t) const
     {
-        if (func) {
-            _funcs.emplace_back(new _MemberFunctionWrapper<TObject>(obj, func));
-        }
+        return IsNull();
     }
 
-    template <typename TObject>
-    void Add(const TObject &obj, TRet (TObject::*func)(Args...) const)
+    bool operator!=(std::nullptr_t) const
     {
-        if (func) {
-            _funcs.emplace_back(new _ConstMemberFunctionWrapper<TObject>(obj, func));
-        }
+        return !IsNull();
     }
 
-    template <typename TCallableObject>
-    Delegate &operator+=(const TCallableObject &callable)
+private:
+    template <typename T, typename... TArgs>
+    void _Create(TArgs &&...args)
     {
-        Add(callable);
-        return *this;
+        new (_storage.buf) T(std::forward<TArgs>(args)...);
+        _invoke  = &_CallableOps<T>::Invoke;
+        _manager = _CallableOps<T>::GetManager();
     }
 
-    Delegate &operator+=(TRet (*ptr)(Args...))
+    _DELEGATE_COLD static TRet _InvokeEmpty(const _Storage &, Args &&...) noexcept(_NoExcept)
     {
-        Add(ptr);
-        return *this;
+        return _Signature::_InvokeEmpty(std::integral_constant<bool, _NoExcept>());
     }
+};
 
-    Delegate &operator+=(std::nullptr_t)
-    {
-        return *this;
-    }
+// A multicast delegate whose handlers are part of its type, e.g. for pipelines known at compile time.
+// Invoking it calls the handlers directly in order, so the calls can be inlined. Like Delegate it returns
+// the result of the last handler, all handlers but the last share the arguments and the last one receives
+// them forwarded. ToDelegate converts it to a Delegate that holds each handler separately, it can also be
+// added to a Delegate as a single callable. See MakeStaticMulticast.
+template <typename... Handlers>
+class StaticMulticast final
+{
+    static_assert(sizeof...(Handlers) > 0, "StaticMulticast requires at least one handler");
 
-    template <typename TCallableObject>
-    void Remove(const TCallableObject &callable)
+private:
+    static constexpr size_t _Count = sizeof...(Handlers);
+
+    template <size_t I>
+    using _Handler = typename std::tuple_element<I, std::tuple<Handlers...>>::type;
+
+    template <typename... TArgs>
+    struct _Types {
+    };
+
+    template <typename T, typename... TArgs>
+    struct _AcceptsSharedArgs {
+        template <typename U>
+        static auto Test(int) -> decltype(std::declval<const U &>()(std::declval<_DelegateSharedArg<TArgs>>()...), std::true_type());
+        template <typename U>
+        static std::false_type Test(...);
+        using type = decltype(Test<T>(0));
+    };
+
+    std::tuple<Handlers...> _handlers;
+
+public:
+    StaticMulticast() = default;
+
+    explicit StaticMulticast(Handlers... handlers)
+        : _handlers(std::move(handlers)...)
     {
-        _CallableObjectWrapper<TCallableObject> wrapper(callable);
-        _Remove(wrapper);
     }
 
-    void Remove(TRet (*ptr)(Args...))
+    template <typename... TArgs>
+    auto operator()(TArgs &&...args) const -> decltype(std::declval<const _Handler<_Count - 1> &>()(std::forward<TArgs>(args)...))
     {
-        if (ptr) {
-            _CallableObjectWrapper<decltype(ptr)> wrapper(ptr);
-            _Remove(wrapper);
-        }
+        _InvokeFirst<0>(std::integral_constant<bool, (_Count > 1)>(), _Types<TArgs...>(), args...);
+        return std::get<_Count - 1>(_handlers)(std::forward<TArgs>(args)...);
     }
 
-    void Remove(std::nullptr_t)
+    template <size_t I>
+    const _Handler<I> &Get() const
     {
+        return std::get<I>(_handlers);
     }
 
-    template <typename TObject>
-    void Remove(TObject &obj, TRet (TObject::*func)(Args...))
+    template <size_t I>
+    _Handler<I> &Get()
     {
-        if (func) {
-            _MemberFunctionWrapper<TObject> wrapper(obj, func);
-            _Remove(wrapper);
-        }
+        return std::get<I>(_handlers);
     }
 
-    template <typename TObject>
-    void Remove(const TObject &obj, TRet (TObject::*func)(Args...) const)
+    // Returns a Delegate that invokes copies of the handlers, they are added one by one.
+    template <typename TSignature, size_t InlineCount = 1>
+    Delegate<TSignature, InlineCount> ToDelegate() const
     {
-        if (func) {
-            _ConstMemberFunctionWrapper<TObject> wrapper(obj, func);
-            _Remove(wrapper);
-        }
+        Delegate<TSignature, InlineCount> result;
+        _AddTo<0>(result, std::true_type());
+        return result;
     }
 
-    template <typename TCallableObject>
-    Delegate &operator-=(const TCallableObject &callable)
+private:
+    template <size_t I, typename... TArgs>
+    void _InvokeFirst(std::true_type, _Types<TArgs...> types, typename std::remove_reference<TArgs>::type &...args) const
     {
-        Remove(callable);
-        return *this;
+        _InvokeShared(std::get<I>(_handlers), typename _AcceptsSharedArgs<_Handler<I>, TArgs...>::type(), types, args...);
+        _InvokeFirst<I + 1>(std::integral_constant<bool, (I + 2 < _Count)>(), types, args...);
     }
 
-    Delegate &operator-=(TRet (*ptr)(Args...))
+    template <size_t I, typename... TArgs>
+    void _InvokeFirst(std::false_type, _Types<TArgs...>, typename std::remove_reference<TArgs>::type &...) const
     {
-        Remove(ptr);
-        return *this;
     }
 
-    Delegate &operator-=(std::nullptr_t)
+    template <typename T, typename... TArgs>
+    static void _InvokeShared(const T &handler, std::true_type, _Types<TArgs...>, typename std::remove_reference<TArgs>::type &...args)
     {
-        return *this;
+        handler(static_cast<_DelegateSharedArg<TArgs>>(args)...);
     }
 
-    bool operator==(const Delegate &other) const
+    // The handler only accepts rvalues, it receives its own copy of the arguments.
+    template <typename T, typename... TArgs>
+    static void _InvokeShared(const T &handler, std::false_type, _Types<TArgs...>, typename std::remove_reference<TArgs>::type &...args)
     {
-        if (this == &other) {
-            return true;
-        }
-        if (_funcs.size() != other._funcs.size()) {
-            return false;
-        }
-        for (size_t i = 0; i < _funcs.size(); ++i) {
-            if (!_funcs[i]->Equals(*other._funcs[i])) {
-                return false;
-            }
-        }
-        return true;
+        handler(static_cast<_DelegateOwnArg<TArgs>>(args)...);
     }
 
-    bool operator!=(const Delegate &other) const
+    template <size_t I, typename TDelegate>
+    void _AddTo(TDelegate &result, std::true_type) const
     {
-        return !(*this == other);
+        result.Add(std::get<I>(_handlers));
+        _AddTo<I + 1>(result, std::integral_constant<bool, (I + 1 < _Count)>());
     }
 
-private:
-    void _Remove(_ICallable &callable)
+    template <size_t I, typename TDelegate>
+    void _AddTo(TDelegate &, std::false_type) const
     {
-        for (size_t i = _funcs.size(); i > 0; --i) {
-            if (_funcs[i - 1]->Equals(callable)) {
-                _funcs.erase(_funcs.begin() + (i - 1));
-                return;
-            }
-        }
     }
 };
 
-template <typename T>
-using Func = Delegate<T>;
+#if _DELEGATE_CPLUSPLUS < 201703L
+template <typename... Handlers>
+constexpr size_t StaticMulticast<Handlers...>::_Count;
+#endif
 
-template <typename... Args>
-using Action = Delegate<void(Args...)>;
+// Creates a StaticMulticast from copies of the handlers, e.g. auto event = MakeStaticMulticast(parse, validate, store).
+template <typename... Handlers>
+StaticMulticast<typename std::decay<Handlers>::type...> MakeStaticMulticast(Handlers &&...handlers)
+{
+    return StaticMulticast<typename std::decay<Handlers>::type...>(std::forward<Handlers>(handlers)...);
+}
 
 #endif // _DELEGATE_H_
@@ -0,0 +1,238 @@
+#ifndef _DELEGATE_THREAD_POOL_H_
+#define _DELEGATE_THREAD_POOL_H_
+
+#include "delegate.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool used by Delegate::InvokeParallel.
+// Each worker owns a task queue, it runs its own tasks in LIFO order and steals from the front of the
+// other queues when it runs out of work. The thread waiting for a parallel loop runs tasks as well.
+class DelegateThreadPool final
+{
+private:
+    struct _Job {
+        std::atomic<size_t> remaining;
+#if !defined(DELEGATE_NO_EXCEPTIONS)
+        std::exception_ptr error;
+        std::mutex errorMutex;
+#endif
+    };
+
+    struct _Task {
+        void (*func)(void *body, size_t begin, size_t end);
+        void *body;
+        size_t begin;
+        size_t end;
+        _Job *job;
+    };
+
+    struct _Queue {
+        std::mutex mutex;
+        std::deque<_Task> tasks;
+    };
+
+private:
+    std::vector<std::unique_ptr<_Queue>> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _inlineThreshold;
+    std::atomic<size_t> _queuedCount;
+    std::atomic<size_t> _nextQueue;
+    std::mutex _wakeMutex;
+    std::condition_variable _wakeCondition;
+    bool _stopping;
+
+public:
+    // Loops with fewer than inlineThreshold iterations run on the calling thread.
+    explicit DelegateThreadPool(size_t threadCount = _DefaultThreadCount(), size_t inlineThreshold = 8)
+        : _inlineThreshold(inlineThreshold), _queuedCount(0), _nextQueue(0), _stopping(false)
+    {
+        for (size_t i = 0; i < threadCount; ++i) {
+            _queues.emplace_back(new _Queue);
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            _threads.emplace_back(&DelegateThreadPool::_WorkerLoop, this, i);
+        }
+    }
+
+    DelegateThreadPool(const DelegateThreadPool &)            = delete;
+    DelegateThreadPool &operator=(const DelegateThreadPool &) = delete;
+
+    ~DelegateThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _stopping = true;
+        }
+        _wakeCondition.notify_all();
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+    }
+
+    static DelegateThreadPool &Default()
+    {
+        static DelegateThreadPool pool;
+        return pool;
+    }
+
+    size_t GetThreadCount() const
+    {
+        return _threads.size();
+    }
+
+    size_t GetInlineThreshold() const
+    {
+        return _inlineThreshold.load(std::memory_order_relaxed);
+    }
+
+    void SetInlineThreshold(size_t inlineThreshold)
+    {
+        _inlineThreshold.store(inlineThreshold, std::memory_order_relaxed);
+    }
+
+    // Calls body(begin, end) for chunks covering [0, count) and returns after all of them have finished.
+    // The first exception thrown by body is rethrown after the loop has finished.
+    template <typename TBody>
+    void ParallelFor(size_t count, TBody &body)
+    {
+        size_t threadCount = _threads.size();
+        if (count == 0) {
+            return;
+        }
+        if (threadCount == 0 || count < GetInlineThreshold()) {
+            body(size_t(0), count);
+            return;
+        }
+
+        size_t chunkCount = (threadCount + 1) * 4;
+        size_t chunkSize  = (count + chunkCount - 1) / chunkCount;
+        chunkCount        = (count + chunkSize - 1) / chunkSize;
+
+        _Job job;
+        job.remaining.store(chunkCount, std::memory_order_relaxed);
+
+        size_t queue = _nextQueue.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 1; i < chunkCount; ++i) {
+            size_t begin = i * chunkSize;
+            size_t end   = begin + chunkSize < count ? begin + chunkSize : count;
+            _Push(queue++ % threadCount, {&_InvokeBody<TBody>, &body, begin, end, &job});
+        }
+
+        // The calling thread runs the first chunk itself and helps with the rest until the loop has finished.
+        _Run({&_InvokeBody<TBody>, &body, 0, chunkSize, &job});
+        while (job.remaining.load(std::memory_order_acquire) != 0) {
+            if (!_TryRunTask(queue % threadCount, false)) {
+                std::this_thread::yield();
+            }
+        }
+#if !defined(DELEGATE_NO_EXCEPTIONS)
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+#endif
+    }
+
+private:
+    static size_t _DefaultThreadCount()
+    {
+        // The thread that starts a parallel loop takes part in it.
+        unsigned count = std::thread::hardware_concurrency();
+        return count > 1 ? count - 1 : 0;
+    }
+
+    template <typename TBody>
+    static void _InvokeBody(void *body, size_t begin, size_t end)
+    {
+        (*static_cast<TBody *>(body))(begin, end);
+    }
+
+    static void _Run(const _Task &task)
+    {
+#if defined(DELEGATE_NO_EXCEPTIONS)
+        task.func(task.body, task.begin, task.end);
+#else
+        try {
+            task.func(task.body, task.begin, task.end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(task.job->errorMutex);
+            if (!task.job->error) {
+                task.job->error = std::current_exception();
+            }
+        }
+#endif
+        // The job may be destroyed as soon as remaining reaches zero.
+        task.job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void _Push(size_t queueIndex, const _Task &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_queues[queueIndex]->mutex);
+            _queues[queueIndex]->tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _queuedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        _wakeCondition.notify_one();
+    }
+
+    bool _TryPop(size_t queueIndex, bool back, _Task &task)
+    {
+        _Queue &queue = *_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (back) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    // Runs a task from the given queue, or steals one from another queue.
+    bool _TryRunTask(size_t queueIndex, bool ownQueue)
+    {
+        size_t queueCount = _queues.size();
+        for (size_t i = 0; i < queueCount; ++i) {
+            _Task task;
+            if (_TryPop((queueIndex + i) % queueCount, ownQueue && i == 0, task)) {
+                _queuedCount.fetch_sub(1, std::memory_order_relaxed);
+                _Run(task);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void _WorkerLoop(size_t index)
+    {
+        for (;;) {
+            if (_TryRunTask(index, true)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            _wakeCondition.wait(lock, [this] {
+                return _stopping || _queuedCount.load(std::memory_order_relaxed) != 0;
+            });
+            if (_stopping && _queuedCount.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+        }
+    }
+};
+
+#endif // _DELEGATE_THREAD_POOL_H_
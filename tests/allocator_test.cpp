@@ -0,0 +1,140 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <new>
+#include <string>
+
+struct Arena {
+    size_t allocations = 0;
+    size_t live        = 0;
+};
+
+// Has no default constructor, delegates using it must always be given one.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    Arena *arena;
+
+    explicit ArenaAllocator(Arena &arena)
+        : arena(&arena)
+    {
+    }
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other)
+        : arena(other.arena)
+    {
+    }
+    T *allocate(size_t n)
+    {
+        ++arena->allocations;
+        ++arena->live;
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t)
+    {
+        --arena->live;
+        ::operator delete(p);
+    }
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const
+    {
+        return arena == other.arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const
+    {
+        return arena != other.arena;
+    }
+};
+
+using ArenaDelegate = Delegate<int(int), 1, ArenaAllocator<char>>;
+
+static int F1(int x)
+{
+    return x + 1;
+}
+
+static int F2(int x)
+{
+    return x + 2;
+}
+
+// Copies and moves take the allocator of their source.
+static void TestCopyWithoutDefaultAllocator()
+{
+    Arena arena;
+    {
+        ArenaDelegate d{ArenaAllocator<char>(arena)};
+        d += F1;
+        d += F2;
+        size_t allocations = arena.allocations;
+        ArenaDelegate copy = d;
+        CHECK(arena.allocations == allocations && copy(1) == 3);
+        copy += F1;
+        CHECK(arena.allocations == allocations + 1 && copy(1) == 2);
+        ArenaDelegate moved = std::move(copy);
+        CHECK(arena.allocations == allocations + 1 && moved(1) == 2 && copy.IsNull());
+
+        Arena other;
+        ArenaDelegate rebound(d, ArenaAllocator<char>(other));
+        CHECK(other.allocations == 1 && rebound == d);
+    }
+    CHECK(arena.live == 0);
+}
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t allocations = 0;
+    size_t live        = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// The heap invocation list and the boxed callables of copies and moves come from the resource.
+static void TestPmrDelegate()
+{
+    CountingResource resource;
+    {
+        std::string text(100, 'x');
+        PmrDelegate<int(int)> d{std::pmr::polymorphic_allocator<char>(&resource)};
+        d += F1;
+        d += [text](int x) { return x + static_cast<int>(text.size()); };
+        size_t allocations = resource.allocations;
+        CHECK(allocations != 0 && d(1) == 101);
+        PmrDelegate<int(int)> copy = d;
+        CHECK(resource.allocations == allocations);
+        copy += F2;
+        CHECK(resource.allocations > allocations && copy(1) == 3);
+        allocations                 = resource.allocations;
+        PmrDelegate<int(int)> moved = std::move(copy);
+        CHECK(resource.allocations == allocations && moved(1) == 3);
+    }
+    CHECK(resource.live == 0);
+}
+#endif
+
+int main()
+{
+    TestCopyWithoutDefaultAllocator();
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    TestPmrDelegate();
+#endif
+    return 0;
+}
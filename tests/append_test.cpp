@@ -0,0 +1,104 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <list>
+#include <vector>
+
+static std::vector<int> g_calls;
+
+static void F1(int)
+{
+    g_calls.push_back(1);
+}
+
+static void F2(int)
+{
+    g_calls.push_back(2);
+}
+
+static void F3(int)
+{
+    g_calls.push_back(3);
+}
+
+static std::vector<int> Calls(const Action<int> &d)
+{
+    g_calls.clear();
+    d(0);
+    return g_calls;
+}
+
+static void TestAppend()
+{
+    Action<int> a, b;
+    a += F1;
+    a += F2;
+    b += F3;
+    Action<int> c = a + b;
+    CHECK((Calls(c) == std::vector<int>{1, 2, 3}));
+    // Appended callables are removed one by one.
+    c -= F2;
+    CHECK((Calls(c) == std::vector<int>{1, 3}));
+    CHECK((Calls(a) == std::vector<int>{1, 2}));
+}
+
+static void TestAppendToSelf()
+{
+    Action<int> d;
+    d += F1;
+    d += F2;
+    d.Append(d);
+    CHECK((Calls(d) == std::vector<int>{1, 2, 1, 2}));
+    Delegate<void(int), 4> inlined;
+    inlined += F1;
+    inlined.Append(inlined);
+    inlined.Append(inlined);
+    inlined.Append(inlined);
+    g_calls.clear();
+    inlined(0);
+    CHECK(g_calls.size() == 8);
+    Action<int> empty;
+    empty.Append(empty);
+    CHECK(empty.IsNull());
+}
+
+static void TestAppendSkipsRemovedEntries()
+{
+    Action<int> source;
+    DelegateHandle handle = source.AddWithHandle(F1);
+    source += F2;
+    source += F3;
+    source.Remove(handle);
+    Action<int> d;
+    d += F3;
+    d.Append(source);
+    CHECK((Calls(d) == std::vector<int>{3, 2, 3}));
+    Action<int> empty;
+    empty.Append(source);
+    CHECK((Calls(empty) == std::vector<int>{2, 3}));
+    // The handle of source does not identify the appended callable.
+    empty.Remove(handle);
+    CHECK((Calls(empty) == std::vector<int>{2, 3}));
+}
+
+static void TestAddRange()
+{
+    std::vector<void (*)(int)> functions(100, F1);
+    functions[50] = nullptr;
+    Action<int> d;
+    d.AddRange(functions.begin(), functions.end());
+    CHECK(Calls(d).size() == 99);
+    std::list<Action<int>> delegates{Action<int>(F1), Action<int>(F2)};
+    Action<int> nested;
+    nested.AddRange(delegates.begin(), delegates.end());
+    CHECK((Calls(nested) == std::vector<int>{1, 2}));
+}
+
+int main()
+{
+    TestAppend();
+    TestAppendToSelf();
+    TestAppendSkipsRemovedEntries();
+    TestAddRange();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "delegate.h"
+#include "test.h"
+
+static int g_sum = 0;
+
+static void F(int x)
+{
+    g_sum += x;
+}
+
+static void G(int x)
+{
+    g_sum += 2 * x;
+}
+
+struct Counter {
+    int total = 0;
+    void Add(int x)
+    {
+        total += x;
+    }
+    void AddTwice(int x)
+    {
+        total += 2 * x;
+    }
+    int Get(int x) const
+    {
+        return total + x;
+    }
+};
+
+static void TestFunctions()
+{
+    Action<int> d;
+    d += Action<int>::Bind<&F>();
+    d += Action<int>::Bind<&G>();
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 3);
+    CHECK(d.Contains(Action<int>::Bind<&F>()));
+    d -= Action<int>::Bind<&F>();
+    CHECK(!d.Contains(Action<int>::Bind<&F>()) && d.Contains(Action<int>::Bind<&G>()));
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 2);
+}
+
+// Bound member functions compare equal for the same object and member function.
+static void TestMethods()
+{
+    Counter a, b;
+    Action<int> d;
+    d += Action<int>::Bind<Counter, &Counter::Add>(a);
+    d += Action<int>::Bind<Counter, &Counter::AddTwice>(a);
+    d += Action<int>::Bind<Counter, &Counter::Add>(b);
+    d(1);
+    CHECK(a.total == 3 && b.total == 1);
+    CHECK(d.Count(Action<int>::Bind<Counter, &Counter::Add>(a)) == 1);
+    d -= Action<int>::Bind<Counter, &Counter::Add>(a);
+    CHECK(!d.Contains(Action<int>::Bind<Counter, &Counter::Add>(a)) && d.Contains(Action<int>::Bind<Counter, &Counter::Add>(b)));
+    d(1);
+    CHECK(a.total == 5 && b.total == 2);
+
+    const Counter &constA = a;
+    Func<int(int)> get = Func<int(int)>::Bind<Counter, &Counter::Get>(constA);
+    CHECK(get(1) == 6);
+}
+
+#if _DELEGATE_CPLUSPLUS >= 201703L
+static void TestAutoMethods()
+{
+    Counter a;
+    Action<int> d;
+    d += Action<int>::Bind<&Counter::Add>(a);
+    d += Action<int>::Bind<&Counter::AddTwice>(a);
+    d(1);
+    CHECK(a.total == 3);
+    d -= Action<int>::Bind<&Counter::Add>(a);
+    d(1);
+    CHECK(a.total == 5);
+    Func<int(int)> get = Func<int(int)>::Bind<&Counter::Get>(static_cast<const Counter &>(a));
+    CHECK(get(1) == 6);
+}
+#endif
+
+int main()
+{
+    TestFunctions();
+    TestMethods();
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    TestAutoMethods();
+#endif
+    return 0;
+}
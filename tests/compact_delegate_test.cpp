@@ -0,0 +1,60 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <string>
+
+static_assert(sizeof(CompactDelegate<void(int)>) == sizeof(void *), "a compact delegate is the size of a pointer");
+static_assert(sizeof(CompactDelegate<std::string(const std::string &)>) == sizeof(void *), "a compact delegate is the size of a pointer");
+
+static int g_sum = 0;
+
+static void F(int x)
+{
+    g_sum += x;
+}
+
+static void TestNullState()
+{
+    CompactDelegate<void(int)> d;
+    CHECK(d.IsNull() && d == nullptr);
+    d += F;
+    CHECK(!d.IsNull() && d != nullptr);
+    d -= F;
+    CHECK(d.IsNull());
+    d += F;
+    d = nullptr;
+    CHECK(d.IsNull());
+    d += F;
+    d.Clear();
+    CHECK(d.IsNull());
+}
+
+static void TestInvocation()
+{
+    std::string text(64, 'x');
+    CompactDelegate<void(int)> d;
+    d += F;
+    d += [text](int x) { g_sum += x * static_cast<int>(text.size()); };
+    CompactDelegate<void(int)> copy = d;
+    CompactDelegate<void(int)> moved = std::move(copy);
+    CHECK(copy.IsNull() && moved == d);
+    g_sum = 0;
+    moved(1);
+    CHECK(g_sum == 65);
+    DelegateHandle handle = d.AddWithHandle(F);
+    d.Remove(handle);
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 65);
+    d.Append(d);
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 130);
+}
+
+int main()
+{
+    TestNullState();
+    TestInvocation();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static_assert(alignof(ConcurrentDelegate<void(int)>) >= 64, "the reader counters are aligned to cache lines");
+
+static std::atomic<long> g_total(0);
+
+static void Always(int &calls)
+{
+    ++calls;
+}
+
+static void Sometimes(int &calls)
+{
+    calls += 100;
+}
+
+struct Big {
+    std::string text;
+    void operator()(int &calls) const
+    {
+        calls += static_cast<int>(text.size());
+    }
+    bool operator==(const Big &other) const
+    {
+        return text == other.text;
+    }
+};
+
+// Raisers must always see a complete snapshot: Always is invoked exactly once, and Big is only present
+// together with Sometimes, since they are appended in one update and removed in reverse order.
+static void TestRaiseDuringAddAndRemove()
+{
+    ConcurrentDelegate<void(int &)> event;
+    event += Always;
+    std::atomic<bool> stop(false);
+    std::atomic<long> raises(0);
+    std::vector<std::thread> raisers;
+    for (int t = 0; t < 4; ++t) {
+        raisers.emplace_back([&] {
+            while (!stop.load()) {
+                int calls = 0;
+                event(calls);
+                CHECK(calls == 1 || calls == 101 || calls == 1101);
+                ++raises;
+            }
+        });
+    }
+    Big big{std::string(1000, 'x')};
+    for (int i = 0; i < 2000; ++i) {
+        Action<int &> pair;
+        pair += Sometimes;
+        pair += big;
+        event.Append(pair);
+        event -= big;
+        event -= Sometimes;
+        if (i % 100 == 0) {
+            event = Action<int &>(Always);
+            std::this_thread::yield();
+        }
+    }
+    stop = true;
+    for (auto &raiser : raisers) {
+        raiser.join();
+    }
+    CHECK(raises.load() > 0);
+    int calls = 0;
+    event(calls);
+    CHECK(calls == 1);
+}
+
+static void TestConcurrentWriters()
+{
+    ConcurrentDelegate<void(int)> event;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&event, t] {
+            for (int i = 0; i < 250; ++i) {
+                event.Add([t, i](int x) { g_total += x; });
+                event(0);
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    g_total = 0;
+    event(1);
+    CHECK(g_total.load() == 1000);
+}
+
+static void TestHandlesAndReentrancy()
+{
+    ConcurrentDelegate<void(int)> event;
+    DelegateHandle handle = event.AddWithHandle([](int) { g_total += 1; });
+    event.Add([](int) { g_total += 10; });
+    event.Remove(handle);
+    g_total = 0;
+    event(0);
+    CHECK(g_total.load() == 10);
+    // A handler may modify the event it is invoked by, the running invocation keeps its snapshot.
+    ConcurrentDelegate<void(int)> reentrant;
+    reentrant.Add([&reentrant](int) { reentrant.Add([](int) { g_total += 1; }); });
+    g_total = 0;
+    reentrant(0);
+    reentrant(0);
+    CHECK(g_total.load() == 1);
+}
+
+static void TestEmpty()
+{
+    ConcurrentDelegate<void(int)> event;
+    CHECK(event.IsNull());
+    event += [](int) {};
+    CHECK(!event.IsNull());
+    event = nullptr;
+    CHECK(event.IsNull());
+    bool threw = false;
+    try {
+        event(0);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main()
+{
+    TestRaiseDuringAddAndRemove();
+    TestConcurrentWriters();
+    TestHandlesAndReentrancy();
+    TestEmpty();
+    return 0;
+}
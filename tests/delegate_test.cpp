@@ -0,0 +1,340 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static size_t g_allocations = 0;
+
+// Kept out of line, so that the compiler does not pair the malloc and free calls with new and delete.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void *Allocate(size_t size)
+{
+    return std::malloc(size ? size : 1);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void Deallocate(void *p)
+{
+    std::free(p);
+}
+
+void *operator new(size_t size)
+{
+    ++g_allocations;
+    if (void *p = Allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    Deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    Deallocate(p);
+}
+
+static int g_sum = 0;
+
+static int F1(int x)
+{
+    g_sum += x;
+    return x + 1;
+}
+
+static int F2(int x)
+{
+    g_sum += 2 * x;
+    return x + 2;
+}
+
+struct Obj {
+    int v = 10;
+    int M(int x)
+    {
+        g_sum += v + x;
+        return v;
+    }
+    int C(int x) const
+    {
+        g_sum += v * x;
+        return -v;
+    }
+};
+
+static void TestSingleCallableDoesNotAllocate()
+{
+    size_t before = g_allocations;
+    Func<int(int)> d = F1;
+    Func<int(int)> copy = d;
+    CHECK(copy(1) == 2);
+    Func<int(int)> moved = std::move(copy);
+    CHECK(moved(1) == 2 && copy == nullptr);
+    Obj obj;
+    Func<int(int)> method(obj, &Obj::M);
+    CHECK(Func<int(int)>(method)(1) == 10);
+    int a = 1, b = 2, c = 3;
+    Func<int(int)> lambda = [a, b, c](int x) { return a + b + c + x; };
+    CHECK(Func<int(int)>(lambda)(1) == 7);
+    CHECK(g_allocations == before);
+}
+
+static void TestMulticastOrderAndRemove()
+{
+    Func<int(int)> d;
+    CHECK(d.IsNull());
+    d += F1;
+    d += F2;
+    Obj obj;
+    d.Add(obj, &Obj::M);
+    const Obj &constObj = obj;
+    d.Add(constObj, &Obj::C);
+    g_sum = 0;
+    CHECK(d(1) == -10);
+    CHECK(g_sum == 1 + 2 + 11 + 10);
+    Func<int(int)> copy = d;
+    CHECK(copy == d);
+    d.Remove(constObj, &Obj::C);
+    CHECK(copy != d);
+    CHECK(d(1) == 10);
+    d.Remove(obj, &Obj::M);
+    d -= F1;
+    CHECK(d(1) == 3);
+    d -= F2;
+    CHECK(d == nullptr);
+    bool threw = false;
+    try {
+        d(1);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+static void TestInlineCapacity()
+{
+    size_t before = g_allocations;
+    Obj obj;
+    Func<int(int), 4> d = F1;
+    d += F2;
+    d.Add(obj, &Obj::M);
+    d += [](int x) { return x * 100; };
+    Func<int(int), 4> copy  = d;
+    Func<int(int), 4> moved = std::move(copy);
+    CHECK(moved == d && copy == nullptr);
+    g_sum = 0;
+    CHECK(d(1) == 100 && g_sum == 1 + 2 + 11);
+    CHECK(g_allocations == before);
+    d += F1; // spills to the heap
+    CHECK(g_allocations > before);
+    g_sum = 0;
+    CHECK(d(1) == 2 && g_sum == 1 + 2 + 11 + 1);
+}
+
+static void TestCopyOnWrite()
+{
+    Func<int(int)> d;
+    for (int i = 0; i < 50; ++i) {
+        d += (i % 2 ? F1 : F2);
+    }
+    size_t before = g_allocations;
+    Func<int(int)> copy = d;
+    CHECK(g_allocations == before && copy == d);
+    copy += F1;
+    CHECK(g_allocations > before && copy != d);
+    CHECK(d.Count(F1) == 25 && copy.Count(F1) == 26);
+}
+
+static void TestNonTrivialCallables()
+{
+    std::string text(100, 'x');
+    std::vector<int> order;
+    Action<int> d;
+    for (int i = 0; i < 40; ++i) {
+        if (i % 5 == 0) {
+            d += [&order, i, text](int) { order.push_back(i + static_cast<int>(text.size()) * 0); };
+        } else {
+            d += [&order, i](int) { order.push_back(i); };
+        }
+    }
+    Action<int> copy = d;
+    copy += [](int) {};
+    d = Action<int>();
+    copy(0);
+    CHECK(order.size() == 40);
+    for (int i = 0; i < 40; ++i) {
+        CHECK(order[i] == i);
+    }
+}
+
+static int g_live = 0;
+
+struct Live {
+    Live()
+    {
+        ++g_live;
+    }
+    Live(const Live &)
+    {
+        ++g_live;
+    }
+    ~Live()
+    {
+        --g_live;
+    }
+};
+
+struct ThrowingCopy {
+    ThrowingCopy() = default;
+    ThrowingCopy(const ThrowingCopy &)
+    {
+        throw std::runtime_error("copy");
+    }
+    ThrowingCopy(ThrowingCopy &&) noexcept
+    {
+    }
+    void operator()(int) const
+    {
+    }
+};
+
+// The callables copied before a copy throws are destroyed.
+static void TestThrowingCopy()
+{
+    {
+        Live live;
+        Delegate<void(int), 4> d;
+        d += [live](int) {};
+        d += ThrowingCopy();
+        bool thrown = false;
+        try {
+            Delegate<void(int), 4> copy = d;
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        CHECK(thrown && g_live == 2);
+        Delegate<void(int), 4> assigned;
+        try {
+            assigned = d;
+        } catch (const std::runtime_error &) {
+        }
+        assigned.Clear();
+        CHECK(g_live == 2);
+
+        Action<int> shared;
+        shared += [live](int) {};
+        shared += [live](int) {};
+        shared += ThrowingCopy();
+        Action<int> copy = shared;
+        thrown           = false;
+        try {
+            copy += [](int) {};
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        CHECK(thrown && g_live == 4 && copy == shared);
+    }
+    CHECK(g_live == 0);
+}
+
+static void TestNestedDelegates()
+{
+    Func<int(int)> inner = F1;
+    inner += F2;
+    Func<int(int)> outer = inner;
+    outer += inner;
+    CHECK(outer(1) == 3);
+    outer -= inner;
+    CHECK(outer == inner);
+    outer += outer;
+    CHECK(outer(1) == 3);
+}
+
+template <size_t InlineCount>
+struct RemoveSelf {
+    Delegate<void(), InlineCount> *d;
+    int *calls;
+    std::string text;
+
+    void operator()() const
+    {
+        *d -= *this;
+        *calls += static_cast<int>(text.size()) / 100;
+    }
+    bool operator==(const RemoveSelf &other) const
+    {
+        return d == other.d;
+    }
+};
+
+// Callables may change the delegate that is invoking them, the changes take effect from the next raise.
+template <size_t InlineCount>
+static void TestReentrantChanges()
+{
+    std::string text(100, 'x');
+    int calls = 0;
+    bool added = false;
+    Delegate<void(), InlineCount> d;
+    d += [&calls, text] { ++calls; };
+    d += [&, text] {
+        ++calls;
+        if (!added) {
+            added = true;
+            for (int i = 0; i < 8; ++i) {
+                d += [&calls, text] { ++calls; };
+            }
+        }
+        CHECK(text.size() == 100);
+    };
+    d();
+    CHECK(calls == 2);
+    calls = 0;
+    d();
+    CHECK(calls == 10);
+
+    calls = 0;
+    d.Clear();
+    d += [&calls, text] { ++calls; };
+    d += [&, text] {
+        ++calls;
+        d.Clear();
+        CHECK(text.size() == 100);
+    };
+    d += [&calls, text] { ++calls; };
+    d();
+    CHECK(calls == 3 && d.IsNull());
+
+    calls = 0;
+    d += [&calls, text] { ++calls; };
+    d += RemoveSelf<InlineCount>{&d, &calls, text};
+    d += [&calls, text] { ++calls; };
+    d();
+    CHECK(calls == 3);
+    calls = 0;
+    d();
+    CHECK(calls == 2);
+}
+
+int main()
+{
+    TestSingleCallableDoesNotAllocate();
+    TestMulticastOrderAndRemove();
+    TestInlineCapacity();
+    TestCopyOnWrite();
+    TestNonTrivialCallables();
+    TestThrowingCopy();
+    TestNestedDelegates();
+    TestReentrantChanges<1>();
+    TestReentrantChanges<4>();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "delegate.h"
+#include "delegate_thread_pool.h"
+#include "test.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> g_seen;
+
+static void ByValue(std::string s)
+{
+    g_seen.push_back(s);
+}
+
+static void ByConstRef(const std::string &s)
+{
+    g_seen.push_back(s);
+}
+
+// Moves from its argument, it must not take it from the callables that follow.
+static void ByRvalue(std::string &&s)
+{
+    std::string taken = std::move(s);
+    g_seen.push_back(taken);
+}
+
+static bool AllSaw(const char *expected, size_t count)
+{
+    if (g_seen.size() != count) {
+        return false;
+    }
+    for (const std::string &s : g_seen) {
+        if (s != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestDelegate()
+{
+    Delegate<void(std::string)> d;
+    d += ByValue;
+    d += ByValue;
+    d += ByRvalue;
+    d += ByRvalue;
+    d += ByConstRef;
+    d += ByValue;
+    g_seen.clear();
+    d("xy");
+    CHECK(AllSaw("xy", 6));
+
+    // The caller's lvalue is never moved from.
+    std::string arg = "xy";
+    g_seen.clear();
+    d(arg);
+    CHECK(AllSaw("xy", 6) && arg == "xy");
+}
+
+static void TestRvalueReferenceSignature()
+{
+    Delegate<void(std::string &&)> d;
+    d += ByRvalue;
+    d += ByConstRef;
+    d += ByRvalue;
+    std::string arg = "xy";
+    g_seen.clear();
+    d(std::move(arg));
+    CHECK(AllSaw("xy", 3));
+}
+
+static void TestStaticDelegate()
+{
+    StaticDelegate<void(std::string), 4> d;
+    d += ByRvalue;
+    d += ByValue;
+    d += ByRvalue;
+    d += ByValue;
+    g_seen.clear();
+    d("xy");
+    CHECK(AllSaw("xy", 4));
+}
+
+static void TestStaticMulticast()
+{
+    auto m = MakeStaticMulticast(ByValue, ByRvalue, ByConstRef, ByValue);
+    g_seen.clear();
+    m(std::string("xy"));
+    CHECK(AllSaw("xy", 4));
+}
+
+// Move-only arguments cannot be shared, the last callable receives them forwarded.
+static void TestMoveOnly()
+{
+    int value = 0;
+    Delegate<void(std::unique_ptr<int>)> d;
+    d += [&](const std::unique_ptr<int> &p) { value += *p; };
+    d += [&](std::unique_ptr<int> &&p) {
+        std::unique_ptr<int> taken = std::move(p);
+        value += *taken;
+    };
+    d(std::unique_ptr<int>(new int(21)));
+    CHECK(value == 42);
+}
+
+static void TestParallel()
+{
+    DelegateThreadPool pool(4, 1);
+    std::atomic<size_t> total(0);
+    Delegate<void(std::string)> d;
+    for (int i = 0; i < 20; ++i) {
+        d += [&total](std::string &&s) {
+            std::string taken = std::move(s);
+            total += taken.size();
+        };
+    }
+    for (int i = 0; i < 10; ++i) {
+        d.InvokeParallel(pool, std::string(10, 'x'));
+    }
+    CHECK(total == 20 * 10 * 10);
+}
+
+int main()
+{
+    TestDelegate();
+    TestRvalueReferenceSignature();
+    TestStaticDelegate();
+    TestStaticMulticast();
+    TestMoveOnly();
+    TestParallel();
+    return 0;
+}
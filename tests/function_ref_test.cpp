@@ -0,0 +1,91 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <string>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<FunctionRef<int(int)>>::value, "a FunctionRef is trivially copyable");
+static_assert(sizeof(FunctionRef<int(int)>) == 2 * sizeof(void *), "a FunctionRef is two pointers");
+
+static int Twice(int x)
+{
+    return 2 * x;
+}
+
+struct Scaler {
+    int factor;
+    int Scale(int x)
+    {
+        return factor * x;
+    }
+    int ScaleConst(int x) const
+    {
+        return factor * x + 1;
+    }
+    int ScaleNoexcept(int x) noexcept
+    {
+        return factor * x + 2;
+    }
+};
+
+static int Apply(FunctionRef<int(int)> f, int x)
+{
+    return f(x);
+}
+
+static void TestCallables()
+{
+    int offset = 10;
+    auto add   = [&offset](int x) { return x + offset; };
+    CHECK(Apply(add, 1) == 11);
+    // The lambda is referenced, not copied.
+    offset = 20;
+    FunctionRef<int(int)> ref = add;
+    CHECK(ref(1) == 21);
+
+    CHECK(Apply(Twice, 3) == 6 && Apply(&Twice, 4) == 8);
+
+    // Copies refer to the same callable.
+    FunctionRef<int(int)> copy = ref;
+    offset                     = 30;
+    CHECK(copy(1) == 31);
+}
+
+static void TestMembers()
+{
+    Scaler scaler{3};
+    CHECK(Apply(FunctionRef<int(int)>::Bind<Scaler, &Scaler::Scale>(scaler), 2) == 6);
+    const Scaler &constScaler = scaler;
+    CHECK(Apply(FunctionRef<int(int)>::Bind<Scaler, &Scaler::ScaleConst>(constScaler), 2) == 7);
+#if _DELEGATE_CPLUSPLUS >= 201703L
+    scaler.factor = 4;
+    CHECK(Apply(FunctionRef<int(int)>::Bind<&Scaler::Scale>(scaler), 2) == 8);
+    FunctionRef<int(int) noexcept> noexceptRef = FunctionRef<int(int) noexcept>::Bind<&Scaler::ScaleNoexcept>(scaler);
+    static_assert(noexcept(noexceptRef(2)), "invoking a noexcept FunctionRef is noexcept");
+    CHECK(noexceptRef(2) == 10);
+#endif
+}
+
+// A delegate is invoked through its own invocation list, later changes are visible through the reference.
+static void TestDelegates()
+{
+    std::string log;
+    Action<const char *> d;
+    d += [&log](const char *s) { log += s; };
+    FunctionRef<void(const char *)> ref = d;
+    ref("a");
+    d += [&log](const char *s) {
+        log += s;
+        log += s;
+    };
+    ref("b");
+    CHECK(log == "abbb");
+}
+
+int main()
+{
+    TestCallables();
+    TestMembers();
+    TestDelegates();
+    return 0;
+}
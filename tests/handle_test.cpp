@@ -0,0 +1,155 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <random>
+#include <vector>
+
+static std::vector<int> g_calls;
+
+// Large enough to be stored on the heap, and not trivially copyable.
+struct Handler {
+    int id;
+    std::vector<char> payload;
+    explicit Handler(int id)
+        : id(id), payload(64)
+    {
+    }
+    void operator()(int) const
+    {
+        g_calls.push_back(id);
+    }
+    bool operator==(const Handler &other) const
+    {
+        return id == other.id;
+    }
+};
+
+// Compares a delegate with a model of its invocation list after random adds and removals, removing by handle
+// leaves removed entries behind that are compacted later.
+template <size_t InlineCount>
+static void TestRandomOperations(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    Delegate<void(int), InlineCount> d;
+    std::vector<std::pair<int, DelegateHandle>> model;
+    std::vector<DelegateHandle> stale;
+    int next = 0;
+    for (int step = 0; step < 2000; ++step) {
+        unsigned op = rng() % 10;
+        if (op < 4) {
+            int id = next++;
+            model.push_back({id, d.AddWithHandle(Handler(id))});
+            CHECK(model.back().second);
+        } else if (op < 5) {
+            int id = next++;
+            d.Add([id](int) { g_calls.push_back(id); });
+            model.push_back({id, DelegateHandle()});
+        } else if (op < 8 && !model.empty()) {
+            size_t k = rng() % model.size();
+            if (model[k].second) {
+                d.Remove(model[k].second);
+                stale.push_back(model[k].second);
+                model.erase(model.begin() + k);
+            }
+        } else if (!stale.empty()) {
+            // Removing with a stale handle does nothing.
+            d.Remove(stale[rng() % stale.size()]);
+        }
+        g_calls.clear();
+        if (model.empty()) {
+            CHECK(d.IsNull());
+        } else {
+            d(0);
+        }
+        std::vector<int> expected;
+        for (const auto &entry : model) {
+            expected.push_back(entry.first);
+        }
+        CHECK(g_calls == expected);
+        Delegate<void(int), InlineCount> copy = d;
+        CHECK(copy == d);
+    }
+}
+
+static void TestHandlesAreValidForCopies()
+{
+    Action<int> a;
+    DelegateHandle first = a.AddWithHandle([](int) { g_calls.push_back(1); });
+    a.AddWithHandle([](int) { g_calls.push_back(2); });
+    Action<int> b = a;
+    b.Remove(first);
+    g_calls.clear();
+    b(0);
+    CHECK(g_calls == std::vector<int>{2});
+    g_calls.clear();
+    a(0);
+    CHECK((g_calls == std::vector<int>{1, 2}));
+    a.Remove(first);
+    a.Remove(first);
+    g_calls.clear();
+    a(0);
+    CHECK(g_calls == std::vector<int>{2});
+}
+
+static void TestStaleHandleDoesNotMatchReusedSlot()
+{
+    Action<int> d;
+    DelegateHandle old = d.AddWithHandle([](int) { g_calls.push_back(1); });
+    d.Remove(old);
+    CHECK(d.IsNull());
+    d.AddWithHandle([](int) { g_calls.push_back(2); });
+    d.Remove(old);
+    g_calls.clear();
+    d(0);
+    CHECK(g_calls == std::vector<int>{2});
+    DelegateHandle none;
+    CHECK(!none);
+    d.Remove(none);
+    CHECK(!d.IsNull());
+}
+
+static void TestRemovedEntriesAreCompacted()
+{
+    Action<int> d;
+    std::vector<DelegateHandle> handles;
+    for (int i = 0; i < 100; ++i) {
+        handles.push_back(d.AddWithHandle([i](int) { g_calls.push_back(i); }));
+    }
+    // Removing from the front leaves removed entries that are dropped once they make up half of the list.
+    for (int i = 0; i < 90; ++i) {
+        d.Remove(handles[i]);
+    }
+    g_calls.clear();
+    d(0);
+    CHECK(g_calls.size() == 10 && g_calls.front() == 90 && g_calls.back() == 99);
+    // The remaining handles still identify their callables after compaction.
+    d.Remove(handles[95]);
+    g_calls.clear();
+    d(0);
+    CHECK(g_calls.size() == 9 && g_calls[5] == 96);
+}
+
+static void TestEqualityIgnoresRemovedEntries()
+{
+    auto f = [](int) {};
+    Action<int> x, y;
+    DelegateHandle handle = x.AddWithHandle(+[](int) {});
+    x += f;
+    y += f;
+    CHECK(x != y);
+    x.Remove(handle);
+    CHECK(x == y);
+}
+
+int main()
+{
+    for (unsigned seed = 0; seed < 10; ++seed) {
+        TestRandomOperations<1>(seed);
+        TestRandomOperations<3>(seed);
+    }
+    TestHandlesAreValidForCopies();
+    TestStaleHandleDoesNotMatchReusedSlot();
+    TestRemovedEntriesAreCompacted();
+    TestEqualityIgnoresRemovedEntries();
+    return 0;
+}
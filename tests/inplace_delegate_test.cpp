@@ -0,0 +1,61 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <string>
+#include <utility>
+
+struct Padded {
+    char c;
+    int i;
+    int operator()(int x) const
+    {
+        return x + c + i;
+    }
+};
+
+// Copies and moves of trivially copyable callables only copy the bytes of the callable,
+// the rest of the buffer is never initialized.
+static void TestTrivialCallables()
+{
+    InplaceDelegate<int(int), 16> stateless = [](int x) { return x + 1; };
+    InplaceDelegate<int(int), 16> padded    = Padded{1, 2};
+    InplaceDelegate<int(int), 16> copy      = stateless;
+    InplaceDelegate<int(int), 16> moved     = std::move(padded);
+    CHECK(copy(1) == 2 && moved(1) == 4 && padded.IsNull());
+    copy = moved;
+    CHECK(copy(1) == 4 && copy == moved);
+
+    Delegate<int(int)> d;
+    d += stateless;
+    d += copy;
+    CHECK(d(1) == 4 && d.Contains(stateless));
+}
+
+static void TestNonTrivialCallables()
+{
+    std::string suffix = "!";
+    InplaceDelegate<std::string(std::string), 64> append = [suffix](std::string s) { return s + suffix; };
+    InplaceDelegate<std::string(std::string), 64> copy   = append;
+    InplaceDelegate<std::string(std::string), 64> moved  = std::move(append);
+    CHECK(copy("a") == "a!" && moved("b") == "b!" && append.IsNull());
+}
+
+static void TestStaticDelegateCopies()
+{
+    int calls = 0;
+    StaticDelegate<int(int), 4> d;
+    d += [](int x) { return x; };
+    d += Padded{1, 2};
+    d += [&calls](int x) { return calls += x; };
+    StaticDelegate<int(int), 4> copy  = d;
+    StaticDelegate<int(int), 4> moved = std::move(d);
+    CHECK(copy(1) == 1 && moved(2) == 3 && calls == 3);
+}
+
+int main()
+{
+    TestTrivialCallables();
+    TestNonTrivialCallables();
+    TestStaticDelegateCopies();
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+static int Add1(int x)
+{
+    return x + 1;
+}
+
+static int Add2(int x)
+{
+    return x + 2;
+}
+
+static int Add3(int x)
+{
+    return x + 3;
+}
+
+static void TestInvokeAll()
+{
+    Func<int(int), 4> d;
+    std::vector<int> results;
+    d.InvokeAll(std::back_inserter(results), 10);
+    CHECK(results.empty());
+
+    d += Add1;
+    d += Add2;
+    d += Add3;
+    d.InvokeAll(std::back_inserter(results), 10);
+    CHECK((results == std::vector<int>{11, 12, 13}));
+
+    // Removed entries are skipped.
+    DelegateHandle handle = d.AddWithHandle(Add1);
+    d += Add3;
+    d.Remove(handle);
+    results.clear();
+    d.InvokeAll(std::back_inserter(results), 0);
+    CHECK((results == std::vector<int>{1, 2, 3, 3}));
+
+    int array[4] = {};
+    int *end     = d.InvokeAll(array, 1);
+    CHECK(end == array + 4 && array[0] == 2 && array[3] == 4);
+}
+
+static void TestAggregate()
+{
+    Func<int(int)> d;
+    CHECK(d.Aggregate(-1, [](int acc, int r) { return acc + r; }, 10) == -1);
+    d += Add1;
+    d += Add2;
+    d += Add3;
+    CHECK(d.Aggregate(0, [](int acc, int r) { return acc + r; }, 10) == 36);
+    CHECK(d.Aggregate(0, [](int acc, int r) { return acc > r ? acc : r; }, 10) == 13);
+
+    // The accumulator is moved through the reducer.
+    Func<std::string(const std::string &)> names;
+    names += [](const std::string &s) { return s + "a"; };
+    names += [](const std::string &s) { return s + "b"; };
+    std::string joined = names.Aggregate(std::string(), [](std::string acc, std::string r) { return acc + r + ";"; }, "x");
+    CHECK(joined == "xa;xb;");
+}
+
+// Arguments taken by value are shared by all callables but the last.
+static void TestArguments()
+{
+    Func<size_t(std::string)> d;
+    d += [](std::string s) { return s.size(); };
+    d += [](std::string &&s) {
+        std::string taken = std::move(s);
+        return taken.size();
+    };
+    d += [](std::string s) { return s.size(); };
+    std::vector<size_t> results;
+    d.InvokeAll(std::back_inserter(results), std::string("abc"));
+    CHECK((results == std::vector<size_t>{3, 3, 3}));
+    CHECK(d.Aggregate(size_t(0), [](size_t acc, size_t r) { return acc + r; }, std::string("abcd")) == 12);
+}
+
+int main()
+{
+    TestInvokeAll();
+    TestAggregate();
+    TestArguments();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "delegate.h"
+#include "delegate_thread_pool.h"
+#include "test.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+static std::atomic<long> g_total(0);
+
+static void TestAllCallablesRun()
+{
+    DelegateThreadPool pool(3, 4);
+    Action<const std::vector<int> &> d;
+    for (int i = 0; i < 100; ++i) {
+        d += [](const std::vector<int> &v) { g_total += static_cast<long>(v.size()); };
+    }
+    std::vector<int> v(10);
+    g_total = 0;
+    for (int i = 0; i < 200; ++i) {
+        d.InvokeParallel(pool, v);
+    }
+    CHECK(g_total == 200 * 100 * 10);
+}
+
+// A callable may invoke a delegate in parallel on the same pool, the waiting thread runs queued tasks.
+static void TestNested()
+{
+    DelegateThreadPool pool(3, 4);
+    Action<int> outer;
+    for (int i = 0; i < 16; ++i) {
+        outer += [&pool](int) {
+            Action<int> inner;
+            for (int j = 0; j < 16; ++j) {
+                inner += [](int) { g_total += 1; };
+            }
+            inner.InvokeParallel(pool, 0);
+        };
+    }
+    g_total = 0;
+    outer.InvokeParallel(pool, 0);
+    CHECK(g_total == 256);
+}
+
+static void TestRemovedEntries()
+{
+    DelegateThreadPool pool(2, 1);
+    Action<int> d;
+    std::vector<DelegateHandle> handles;
+    for (int i = 0; i < 40; ++i) {
+        handles.push_back(d.AddWithHandle([](int x) { g_total += x; }));
+    }
+    for (size_t i = 0; i < handles.size(); i += 2) {
+        d.Remove(handles[i]);
+    }
+    g_total = 0;
+    d.InvokeParallel(pool, 1);
+    CHECK(g_total == 20);
+}
+
+#if !defined(DELEGATE_NO_EXCEPTIONS)
+// The first exception is rethrown after all chunks have finished.
+static void TestExceptions()
+{
+    DelegateThreadPool pool(3, 4);
+    Action<int> d;
+    for (int i = 0; i < 40; ++i) {
+        d += [i](int) {
+            if (i == 17) {
+                throw std::runtime_error("handler failed");
+            }
+            g_total += 1;
+        };
+    }
+    g_total    = 0;
+    bool threw = false;
+    try {
+        d.InvokeParallel(pool, 0);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw && g_total == 39);
+}
+#endif
+
+static void TestDefaultPool()
+{
+    Action<int> empty;
+    empty.InvokeParallel(0);
+    Action<int> d;
+    for (int i = 0; i < 50; ++i) {
+        d += [](int x) { g_total += x; };
+    }
+    g_total = 0;
+    d.InvokeParallel(2);
+    CHECK(g_total == 100);
+}
+
+int main()
+{
+    TestAllCallablesRun();
+    TestNested();
+    TestRemovedEntries();
+#if !defined(DELEGATE_NO_EXCEPTIONS)
+    TestExceptions();
+#endif
+    TestDefaultPool();
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+struct Keyed {
+    int key;
+    void operator()(int) const
+    {
+    }
+    bool operator==(const Keyed &other) const
+    {
+        return key == other.key;
+    }
+};
+
+// Like Keyed, but hashed with its std::hash specialization.
+struct Hashed {
+    int key;
+    void operator()(int) const
+    {
+    }
+    bool operator==(const Hashed &other) const
+    {
+        return key == other.key;
+    }
+};
+
+namespace std {
+template <>
+struct hash<Hashed> {
+    size_t operator()(const Hashed &value) const
+    {
+        return std::hash<int>()(value.key);
+    }
+};
+} // namespace std
+
+struct Obj {
+    void M(int)
+    {
+    }
+    void C(int) const
+    {
+    }
+};
+
+static void F(int)
+{
+}
+
+static void G(int)
+{
+}
+
+// Compares the lookups with a model of the invocation list. Removing by handle leaves removed entries behind,
+// which must not be found and must not count for IndexOf.
+template <size_t InlineCount>
+static void TestLookupsWithRemovedEntries(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    Delegate<void(int), InlineCount> d;
+    std::vector<std::pair<int, DelegateHandle>> model;
+    for (int step = 0; step < 3000; ++step) {
+        unsigned op = rng() % 6;
+        int key     = static_cast<int>(rng() % 40);
+        if (op < 2) {
+            model.push_back({key, d.AddWithHandle(Keyed{key})});
+        } else if (op == 2) {
+            bool present = std::any_of(model.begin(), model.end(), [&](const std::pair<int, DelegateHandle> &e) { return e.first == key; });
+            CHECK(d.AddUnique(Keyed{key}) == !present);
+            if (!present) {
+                model.push_back({key, DelegateHandle()});
+            }
+        } else if (op == 3 && !model.empty()) {
+            size_t k = rng() % model.size();
+            if (model[k].second) {
+                d.Remove(model[k].second);
+                model.erase(model.begin() + k);
+            }
+        } else if (op == 4) {
+            d -= Keyed{key};
+            for (size_t i = model.size(); i > 0; --i) {
+                if (model[i - 1].first == key) {
+                    model.erase(model.begin() + (i - 1));
+                    break;
+                }
+            }
+        }
+        int query    = static_cast<int>(rng() % 40);
+        size_t count = 0;
+        size_t index = Delegate<void(int), InlineCount>::npos;
+        for (size_t i = 0; i < model.size(); ++i) {
+            if (model[i].first == query) {
+                index = count == 0 ? i : index;
+                ++count;
+            }
+        }
+        CHECK(d.Count(Keyed{query}) == count);
+        CHECK(d.Contains(Keyed{query}) == (count != 0));
+        CHECK(d.IndexOf(Keyed{query}) == index);
+    }
+}
+
+static void TestLookupsOfFunctionsAndMethods()
+{
+    Obj obj, other;
+    Action<int> d;
+    for (int i = 0; i < 20; ++i) {
+        d += Keyed{i};
+    }
+    d += F;
+    d.Add(obj, &Obj::M);
+    d.Add(obj, &Obj::C);
+    CHECK(d.Contains(F) && !d.Contains(G));
+    CHECK(d.Contains(obj, &Obj::M) && !d.Contains(other, &Obj::M) && d.Contains(obj, &Obj::C));
+    CHECK(d.IndexOf(F) == 20 && d.IndexOf(obj, &Obj::C) == 22 && d.IndexOf(G) == Action<int>::npos);
+    CHECK(!d.AddUnique(F) && d.AddUnique(G) && d.Count(G) == 1);
+    auto bound = Action<int>::Bind<&F>();
+    d += bound;
+    d += bound;
+    CHECK(d.Count(bound) == 2 && d.IndexOf(bound) == 24);
+}
+
+// Captureless lambdas have operator== through their conversion to a function pointer,
+// they must still be identified by their type alone.
+static void TestCapturelessLambdas()
+{
+    auto lambda = [](int) {};
+    static_assert(DelegateCallableTraits<decltype(lambda)>::_AllEqual::value, "captureless lambdas are stateless");
+    static_assert(!DelegateCallableTraits<Keyed>::_AllEqual::value, "Keyed is compared with operator==");
+    Action<int> d;
+    d += F;
+    d += lambda;
+    d += lambda;
+    CHECK(d.Count(lambda) == 2 && d.IndexOf(lambda) == 1);
+    d -= lambda;
+    CHECK(d.Count(lambda) == 1 && d.Contains(F));
+}
+
+// Types with operator== use std::hash when it is specialized for them, so their fingerprints differ.
+static void TestStdHash()
+{
+    using HashedTraits = DelegateCallableTraits<Hashed>;
+    CHECK(HashedTraits::Hash(Hashed{1}) == std::hash<int>()(1));
+    CHECK(HashedTraits::Hash(Hashed{1}) != HashedTraits::Hash(Hashed{2}));
+    CHECK(DelegateCallableTraits<Keyed>::Hash(Keyed{1}) == 0);
+    Action<int> d;
+    for (int i = 0; i < 100; ++i) {
+        d += Hashed{i};
+    }
+    CHECK(d.IndexOf(Hashed{42}) == 42 && d.Contains(Hashed{99}) && !d.Contains(Hashed{100}));
+    d -= Hashed{42};
+    CHECK(!d.Contains(Hashed{42}) && d.IndexOf(Hashed{43}) == 42);
+}
+
+int main()
+{
+    for (unsigned seed = 0; seed < 10; ++seed) {
+        TestLookupsWithRemovedEntries<1>(seed);
+        TestLookupsWithRemovedEntries<4>(seed);
+    }
+    TestLookupsOfFunctionsAndMethods();
+    TestCapturelessLambdas();
+    TestStdHash();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+struct Counts {
+    int copies = 0;
+    int moves  = 0;
+};
+
+// Counts how often it is copied and moved on the way into the delegate.
+struct Tracked {
+    Counts *counts;
+    std::string payload;
+
+    Tracked(Counts *counts, std::string payload)
+        : counts(counts), payload(std::move(payload))
+    {
+    }
+    Tracked(const Tracked &other)
+        : counts(other.counts), payload(other.payload)
+    {
+        ++counts->copies;
+    }
+    Tracked(Tracked &&other) noexcept
+        : counts(other.counts), payload(std::move(other.payload))
+    {
+        ++counts->moves;
+    }
+    size_t operator()() const
+    {
+        return payload.size();
+    }
+};
+
+struct MoveOnly {
+    std::unique_ptr<int> value;
+
+    explicit MoveOnly(int value)
+        : value(new int(value))
+    {
+    }
+    size_t operator()() const
+    {
+        return static_cast<size_t>(*value);
+    }
+};
+
+static void TestMoveOnlyCallables()
+{
+    std::unique_ptr<int> value(new int(0));
+    int *raw = value.get();
+    Action<int> d;
+    d += [value = std::move(value)](int x) { *value += x; };
+    d(1);
+    CHECK(*raw == 1);
+
+    // Copies of the delegate share the move-only callable.
+    Action<int> copy = d;
+    copy(2);
+    d(3);
+    CHECK(*raw == 6);
+    d.Clear();
+    copy(4);
+    CHECK(*raw == 10);
+}
+
+static void TestRvalueAdd()
+{
+    Counts counts;
+    Func<size_t()> d;
+    Tracked tracked(&counts, std::string(100, 'x'));
+    d += std::move(tracked);
+    CHECK(counts.copies == 0 && counts.moves == 1 && d() == 100);
+    Tracked other(&counts, "abc");
+    d += other;
+    CHECK(counts.copies == 1 && d() == 3);
+}
+
+static void TestEmplace()
+{
+    Counts counts;
+    Func<size_t(), 2> d;
+    d.Emplace<Tracked>(&counts, std::string(100, 'x'));
+    d.Emplace<Tracked>(&counts, "abc");
+    CHECK(counts.copies == 0 && counts.moves == 0 && d() == 3);
+
+    // Growing the inline list into a heap list moves the callables, it never copies them.
+    d.Emplace<Tracked>(&counts, "abcd");
+    CHECK(counts.copies == 0 && d() == 4);
+
+    Func<size_t()> moveOnly;
+    moveOnly.Emplace<MoveOnly>(7);
+    Func<size_t()> copy = moveOnly;
+    CHECK(moveOnly() == 7 && copy() == 7);
+}
+
+int main()
+{
+    TestMoveOnlyCallables();
+    TestRvalueAdd();
+    TestEmplace();
+    return 0;
+}
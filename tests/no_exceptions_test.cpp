@@ -0,0 +1,83 @@
+// Built with -fno-exceptions and -fno-rtti, the header must not need either.
+#include "delegate.h"
+#include "test.h"
+
+#if defined(__cpp_exceptions) || defined(__GXX_RTTI)
+#error "this test must be built with -fno-exceptions and -fno-rtti"
+#endif
+
+static_assert(DELEGATE_EMPTY_POLICY == DELEGATE_EMPTY_ABORT, "without exceptions invoking an empty delegate aborts");
+
+static int g_sum = 0;
+
+static void F(int x)
+{
+    g_sum += x;
+}
+
+static int G(int x)
+{
+    return x * 2;
+}
+
+struct Obj {
+    int k = 0;
+    void M(int x)
+    {
+        k += x;
+    }
+};
+
+// Type identity without RTTI: callables of different types never compare equal.
+static void TestTypeIdentity()
+{
+    auto a = [](int x) { g_sum += x; };
+    auto b = [](int x) { g_sum += x; };
+    Action<int> d;
+    d += a;
+    CHECK(d.Contains(a) && !d.Contains(b));
+    d -= b;
+    CHECK(!d.IsNull());
+    d -= a;
+    CHECK(d.IsNull());
+    Obj obj;
+    d.Add(obj, &Obj::M);
+    d += F;
+    CHECK(d.Contains(obj, &Obj::M) && d.Contains(F) && d.IndexOf(F) == 1);
+    g_sum = 0;
+    d(2);
+    CHECK(g_sum == 2 && obj.k == 2);
+}
+
+static void TestTryInvoke()
+{
+    Func<int(int)> f;
+    CHECK(!f.TryInvoke(1));
+    f += G;
+    CHECK(f.TryInvoke(2) == 4);
+    Action<int> a;
+    CHECK(!a.TryInvoke(1));
+    a += F;
+    CHECK(a.TryInvoke(1));
+}
+
+static void TestHandlesAndConcurrentDelegate()
+{
+    Action<int> d;
+    DelegateHandle handle = d.AddWithHandle(F);
+    d.Remove(handle);
+    CHECK(d.IsNull());
+    ConcurrentDelegate<void(int)> event;
+    event += F;
+    g_sum = 0;
+    event(3);
+    CHECK(g_sum == 3);
+}
+
+int main()
+{
+    TestTypeIdentity();
+    TestTryInvoke();
+    TestHandlesAndConcurrentDelegate();
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+static int g_sum = 0;
+
+static void F(int x) noexcept
+{
+    g_sum += x;
+}
+
+static void G(int x)
+{
+    g_sum += 2 * x;
+}
+
+struct Counter {
+    int total = 0;
+    void Add(int x) noexcept
+    {
+        total += x;
+    }
+};
+
+using NoexceptAction = Delegate<void(int) noexcept>;
+
+static_assert(noexcept(std::declval<const NoexceptAction &>()(1)), "invoking a noexcept delegate is noexcept");
+static_assert(!noexcept(std::declval<const Action<int> &>()(1)), "invoking other delegates may throw");
+static_assert(std::is_nothrow_move_constructible<NoexceptAction>::value && std::is_nothrow_move_assignable<NoexceptAction>::value,
+              "delegates move without throwing");
+static_assert(std::is_nothrow_move_constructible<Action<int>>::value && std::is_nothrow_move_assignable<Action<int>>::value,
+              "delegates move without throwing");
+
+static void TestNoexceptCallables()
+{
+    Counter counter;
+    NoexceptAction d;
+    d += F;
+    d += [](int x) noexcept { g_sum += 10 * x; };
+    d.Add(counter, &Counter::Add);
+    d += NoexceptAction::Bind<&Counter::Add>(counter);
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 11 && counter.total == 2);
+    d -= F;
+    CHECK(!d.Contains(F) && d.Contains(counter, &Counter::Add));
+}
+
+// A noexcept function added to a delegate that is not noexcept is stored as a plain function pointer.
+static void TestNoexceptFunctionInOtherDelegate()
+{
+    Action<int> d;
+    d += F;
+    d += G;
+    CHECK(d.Contains(F) && d.IndexOf(G) == 1);
+    d -= F;
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 2);
+}
+
+// Growing a vector moves the delegates instead of copying them, the callables are neither copied nor destroyed.
+static void TestVectorGrowth()
+{
+    struct Tracked {
+        int *copies;
+        void operator()(int) const noexcept
+        {
+        }
+        Tracked(int *copies)
+            : copies(copies)
+        {
+        }
+        Tracked(const Tracked &other)
+            : copies(other.copies)
+        {
+            ++*copies;
+        }
+        Tracked(Tracked &&other) noexcept = default;
+    };
+
+    int copies = 0;
+    std::vector<NoexceptAction> delegates;
+    for (int i = 0; i < 100; ++i) {
+        NoexceptAction d;
+        d += Tracked(&copies);
+        d += F;
+        delegates.push_back(std::move(d));
+    }
+    CHECK(copies == 0);
+    g_sum = 0;
+    for (const NoexceptAction &d : delegates) {
+        d(1);
+    }
+    CHECK(g_sum == 100);
+}
+
+int main()
+{
+    TestNoexceptCallables();
+    TestNoexceptFunctionInOtherDelegate();
+    TestVectorGrowth();
+    return 0;
+}
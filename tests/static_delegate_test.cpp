@@ -0,0 +1,138 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+static size_t g_allocations = 0;
+
+// Kept out of line, so that the compiler does not pair the malloc and free calls with new and delete.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void *Allocate(size_t size)
+{
+    return std::malloc(size ? size : 1);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void Deallocate(void *p)
+{
+    std::free(p);
+}
+
+void *operator new(size_t size)
+{
+    ++g_allocations;
+    if (void *p = Allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    Deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    Deallocate(p);
+}
+
+static int g_sum = 0;
+
+static void F(int x)
+{
+    g_sum += x;
+}
+
+static void G(int x)
+{
+    g_sum += 2 * x;
+}
+
+// Initialized at compile time, it can be raised before main and from other static initializers.
+#if defined(__cpp_constinit)
+#define TEST_CONSTINIT constinit
+#else
+#define TEST_CONSTINIT
+#endif
+
+static TEST_CONSTINIT StaticDelegate<void(int), 4> g_event;
+
+static_assert(StaticDelegate<void(int), 4>::Capacity == 4, "Capacity is MaxHandlers");
+
+static void TestNoAllocation()
+{
+    size_t before = g_allocations;
+    int local     = 0;
+    g_event += F;
+    g_event += G;
+    g_event += [&local](int x) { local += x; };
+    g_sum = 0;
+    g_event(1);
+    StaticDelegate<void(int), 4> copy = g_event;
+    copy -= G;
+    copy(1);
+    CHECK(g_sum == 4 && local == 2);
+    CHECK(g_allocations == before);
+    g_event.Clear();
+}
+
+static void TestOverflow()
+{
+    StaticDelegate<void(int), 2> d;
+    CHECK(d.TryAdd(F) && d.TryAdd(G) && !d.TryAdd(F));
+    bool threw = false;
+    try {
+        d += F;
+    } catch (const std::length_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    // A removal frees a slot.
+    d -= F;
+    CHECK(d.TryAdd(F));
+    g_sum = 0;
+    d(1);
+    CHECK(g_sum == 3);
+}
+
+static void TestComparison()
+{
+    StaticDelegate<void(int), 4> a, b;
+    CHECK(a == b && a == nullptr);
+    a += F;
+    a += G;
+    b += F;
+    CHECK(a != b);
+    b += G;
+    CHECK(a == b);
+    b -= F;
+    b -= G;
+    CHECK(b == nullptr);
+}
+
+static void TestNonTrivialCallables()
+{
+    std::string text(100, 'x');
+    StaticDelegate<size_t(), 2, 64> d;
+    d += [text]() { return text.size(); };
+    StaticDelegate<size_t(), 2, 64> copy  = d;
+    StaticDelegate<size_t(), 2, 64> moved = std::move(d);
+    CHECK(copy() == 100 && moved() == 100);
+}
+
+int main()
+{
+    TestNoAllocation();
+    TestOverflow();
+    TestComparison();
+    TestNonTrivialCallables();
+    return 0;
+}
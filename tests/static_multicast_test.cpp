@@ -0,0 +1,70 @@
+#include "delegate.h"
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+static std::vector<int> g_calls;
+
+static int First(int x)
+{
+    g_calls.push_back(1);
+    return x + 1;
+}
+
+struct Second {
+    int offset;
+    int operator()(int x) const
+    {
+        g_calls.push_back(2);
+        return x + offset;
+    }
+};
+
+static void TestInvocation()
+{
+    auto multicast = MakeStaticMulticast(First, Second{10}, [](int x) {
+        g_calls.push_back(3);
+        return x * 100;
+    });
+    g_calls.clear();
+    CHECK(multicast(2) == 200);
+    CHECK((g_calls == std::vector<int>{1, 2, 3}));
+    CHECK(multicast.Get<1>().offset == 10);
+    multicast.Get<1>().offset = 20;
+    CHECK(multicast.Get<1>()(0) == 20);
+}
+
+// ToDelegate adds each handler separately, so they can be removed one by one.
+static void TestToDelegate()
+{
+    auto multicast = MakeStaticMulticast(First, &First, First);
+    Func<int(int), 4> d = multicast.ToDelegate<int(int), 4>();
+    g_calls.clear();
+    CHECK(d(1) == 2 && g_calls.size() == 3);
+    CHECK(d.Count(First) == 3);
+    d -= First;
+    g_calls.clear();
+    d(1);
+    CHECK(g_calls.size() == 2);
+}
+
+// Added to a Delegate, a multicast is a single callable invoked with the delegate's arguments.
+static void TestInDelegate()
+{
+    std::string log;
+    auto multicast = MakeStaticMulticast([&log](const std::string &s) { log += s; }, [&log](std::string s) { log += s + s; });
+    Action<std::string> d;
+    d += multicast;
+    d += [&log](std::string &&s) { log += "[" + s + "]"; };
+    d("a");
+    CHECK(log == "aaa[a]");
+}
+
+int main()
+{
+    TestInvocation();
+    TestToDelegate();
+    TestInDelegate();
+    return 0;
+}
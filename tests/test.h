@@ -0,0 +1,16 @@
+#ifndef _DELEGATE_TEST_H_
+#define _DELEGATE_TEST_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+// Like assert, but also checked in release builds.
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                                    \
+        }                                                                                    \
+    } while (false)
+
+#endif // _DELEGATE_TEST_H_